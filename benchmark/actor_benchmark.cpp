@@ -0,0 +1,112 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "utils/actor.h"
+
+// Count every heap allocation in the process, from any thread.
+std::atomic<long> allocations{0};
+
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+// Bounces a countdown between two actors: one message in flight at a time,
+// so this measures send-to-receive latency through the pool.
+class player : public actor<long> {
+public:
+    std::shared_ptr<player> peer;
+    std::atomic<bool> &finished;
+
+    player(thread_pool &pool, std::atomic<bool> &finished_) : actor(pool), finished(finished_) {}
+
+protected:
+    void receive(long &n) override {
+        if (n == 0) {
+            finished.store(true, std::memory_order_release);
+        } else {
+            peer->send(n - 1);
+        }
+    }
+};
+
+class sink : public actor<long> {
+public:
+    long sum = 0;
+    std::atomic<long> &received;
+
+    sink(thread_pool &pool, std::atomic<long> &received_) : actor(pool), received(received_) {}
+
+protected:
+    void receive(long &n) override {
+        sum += n;
+        received.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+static void report(const char *name, long messages, std::chrono::steady_clock::duration elapsed, long allocs) {
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << name << ": " << static_cast<long>(messages / seconds) << " msgs/s, "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / messages << " ns/msg, "
+              << static_cast<double>(allocs) / messages << " allocations/msg" << std::endl;
+}
+
+static void ping_pong(thread_pool &pool, long rounds) {
+    std::atomic<bool> finished{false};
+    auto a = std::make_shared<player>(pool, finished);
+    auto b = std::make_shared<player>(pool, finished);
+    a->peer = b;
+    b->peer = a;
+    const long alloc_start = allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    a->send(rounds);
+    while (!finished.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    report("ping-pong", rounds, std::chrono::steady_clock::now() - start, allocations.load() - alloc_start);
+    a->peer.reset();
+    b->peer.reset();
+}
+
+// One sender thread fanning messages out over many actors.
+static void fan_out(thread_pool &pool, int actors, long messages) {
+    std::atomic<long> received{0};
+    std::vector<std::shared_ptr<sink>> sinks;
+    for (int i = 0; i < actors; ++i) {
+        sinks.push_back(std::make_shared<sink>(pool, received));
+    }
+    const long alloc_start = allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < messages; ++i) {
+        sinks[i % actors]->send(i);
+    }
+    while (received.load(std::memory_order_relaxed) < messages) {
+        std::this_thread::yield();
+    }
+    report("fan-out  ", messages, std::chrono::steady_clock::now() - start, allocations.load() - alloc_start);
+}
+
+int main() {
+    thread_pool pool;
+    for (int round = 0; round < 3; ++round) {
+        ping_pong(pool, 1000000);
+        fan_out(pool, 1000, 2000000);
+    }
+    return 0;
+}
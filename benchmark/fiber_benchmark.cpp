@@ -0,0 +1,116 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "data_structure/fiber_queue.h"
+#include "lock/fiber_semaphore.h"
+#include "lock/semaphore.h"
+#include "utils/fiber.h"
+
+static void report(const char *name, long operations, std::chrono::steady_clock::duration elapsed) {
+    std::cout << name << ": " << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / operations
+              << " ns/op" << std::endl;
+}
+
+// Two parties hand a token back and forth through a pair of semaphores.
+static void ping_pong_fibers(thread_pool &pool, long rounds) {
+    fiber_semaphore ping(0), pong(0);
+    const auto start = std::chrono::steady_clock::now();
+    auto a = spawn_fiber(pool, [&] {
+        for (long i = 0; i < rounds; ++i) {
+            ping.release();
+            pong.acquire();
+        }
+    });
+    auto b = spawn_fiber(pool, [&] {
+        for (long i = 0; i < rounds; ++i) {
+            ping.acquire();
+            pong.release();
+        }
+    });
+    a.get();
+    b.get();
+    report("ping-pong, fibers        ", rounds, std::chrono::steady_clock::now() - start);
+}
+
+static void ping_pong_threads(long rounds) {
+    semaphore ping(0), pong(0);
+    const auto start = std::chrono::steady_clock::now();
+    std::thread a([&] {
+        for (long i = 0; i < rounds; ++i) {
+            ping.release();
+            pong.acquire();
+        }
+    });
+    std::thread b([&] {
+        for (long i = 0; i < rounds; ++i) {
+            ping.acquire();
+            pong.release();
+        }
+    });
+    a.join();
+    b.join();
+    report("ping-pong, threads       ", rounds, std::chrono::steady_clock::now() - start);
+}
+
+// 10000 fibers, each blocking in wait_and_pop for its share of the items;
+// the worker count stays at the pool's size.
+static void blocked_consumers(thread_pool &pool, int consumers, long items) {
+    fiber_queue<long> queue;
+    std::vector<task_future<long>> fibers;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < consumers; ++i) {
+        fibers.push_back(spawn_fiber(pool, [&queue, per = items / consumers] {
+            long sum = 0;
+            for (long n = 0; n < per; ++n) {
+                long v;
+                queue.wait_and_pop(v);
+                sum += v;
+            }
+            return sum;
+        }));
+    }
+    for (long i = 0; i < items; ++i) {
+        queue.push(i);
+    }
+    long sum = 0;
+    for (auto &f: fibers) {
+        sum += f.get();
+    }
+    report("10k blocked consumers    ", items, std::chrono::steady_clock::now() - start);
+    if (sum != items * (items - 1) / 2) {
+        std::cout << "wrong sum " << sum << std::endl;
+    }
+}
+
+// Spawn-to-finish cost of a fiber that never blocks (stacks come from the
+// pool after the first round).
+static void spawn_only(thread_pool &pool, long count) {
+    std::vector<task_future<void>> fibers;
+    fibers.reserve(count);
+    const auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < count; ++i) {
+        fibers.push_back(spawn_fiber(pool, [] {}));
+    }
+    for (auto &f: fibers) {
+        f.get();
+    }
+    report("spawn + run empty fiber  ", count, std::chrono::steady_clock::now() - start);
+}
+
+int main() {
+    thread_pool_options options;
+    options.thread_count = 16;
+    thread_pool pool(options);
+    for (int round = 0; round < 3; ++round) {
+        ping_pong_fibers(pool, 200000);
+        ping_pong_threads(200000);
+        blocked_consumers(pool, 10000, 1000000);
+        spawn_only(pool, 10000);
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <sys/resource.h>
+
+#include "utils/thread_pool.h"
+
+// CPU time (user + sys) consumed by the whole process so far.
+std::chrono::microseconds process_cpu_time() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    auto to_us = [](timeval tv) { return std::chrono::seconds(tv.tv_sec) + std::chrono::microseconds(tv.tv_usec); };
+    return std::chrono::duration_cast<std::chrono::microseconds>(to_us(usage.ru_utime) + to_us(usage.ru_stime));
+}
+
+void run(const char *name, idle_policy policy) {
+    thread_pool_options options;
+    options.idle = policy;
+    thread_pool pool(options);
+
+    // Idle CPU: let the workers settle, then measure one quiet second.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto cpu_start = process_cpu_time();
+    auto wall_start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    auto cpu = process_cpu_time() - cpu_start;
+    auto wall = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wall_start);
+
+    // Wake-up latency: submit into an idle pool, time until the task starts.
+    std::vector<long> latencies;
+    for (int i = 0; i < 200; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        auto submitted = std::chrono::steady_clock::now();
+        auto started = pool.submit([] { return std::chrono::steady_clock::now(); }).get();
+        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(started - submitted).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << name << ": " << pool.size() << " workers, idle cpu "
+              << 100.0 * cpu.count() / wall.count() << "% of one core, wake-up p50 "
+              << latencies[latencies.size() / 2] / 1000.0 << "μs p99 "
+              << latencies[latencies.size() * 99 / 100] / 1000.0 << "μs" << std::endl;
+}
+
+int main() {
+    run("busy_yield ", idle_policy::busy_yield());
+    run("default    ", idle_policy{});
+    run("low_latency", idle_policy::low_latency());
+    run("low_power  ", idle_policy::low_power());
+    return 0;
+}
@@ -0,0 +1,160 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "algorithm/parallel_pipeline.h"
+#include "data_structure/threadsafe_queue_linkedlist.h"
+
+// read -> parse -> transform -> write over synthetic text records. read and
+// write are serial (write in input order), parse and transform parallel.
+static constexpr long records = 200000;
+static constexpr int fields = 16;
+
+struct record {
+    long sequence = 0;
+    std::string line;
+    std::vector<uint64_t> values;
+    uint64_t digest = 0;
+};
+
+static std::string read_line(long i) {
+    std::string line;
+    for (int f = 0; f < fields; ++f) {
+        line += std::to_string(i * 31 + f * 7);
+        line += ',';
+    }
+    return line;
+}
+
+static std::vector<uint64_t> parse(const std::string &line) {
+    std::vector<uint64_t> values;
+    values.reserve(fields);
+    uint64_t v = 0;
+    for (char c: line) {
+        if (c == ',') {
+            values.push_back(v);
+            v = 0;
+        } else {
+            v = v * 10 + (c - '0');
+        }
+    }
+    return values;
+}
+
+static uint64_t transform(const std::vector<uint64_t> &values) {
+    uint64_t h = 1469598103934665603ull;
+    for (int round = 0; round < 8; ++round) {
+        for (uint64_t v: values) {
+            h = (h ^ v) * 1099511628211ull;
+        }
+    }
+    return h;
+}
+
+// Order-sensitive, so a reordered write changes the result.
+static void write(uint64_t &checksum, uint64_t digest) { checksum = checksum * 31 + digest; }
+
+static uint64_t run_pipeline(thread_pool &pool, size_t tokens) {
+    uint64_t checksum = 0;
+    parallel_pipeline(pool, tokens,
+                      make_filter<void, record>(filter_mode::serial_in_order, [i = 0L](flow_control &flow) mutable {
+                          record r;
+                          if (i == records) {
+                              flow.stop();
+                              return r;
+                          }
+                          r.sequence = i;
+                          r.line = read_line(i++);
+                          return r;
+                      }) &
+                      make_filter<record, record>(filter_mode::parallel, [](record r) {
+                          r.values = parse(r.line);
+                          return r;
+                      }) &
+                      make_filter<record, record>(filter_mode::parallel, [](record r) {
+                          r.digest = transform(r.values);
+                          return r;
+                      }) &
+                      make_filter<record, void>(filter_mode::serial_in_order,
+                                                [&checksum](record r) { write(checksum, r.digest); }));
+    return checksum;
+}
+
+// The same stages wired by hand: a reader thread, worker threads doing parse
+// and transform, and a writer that restores order with a reorder buffer.
+static uint64_t run_queues(unsigned workers) {
+    threadsafe_queue<record> parsed_in;
+    threadsafe_queue<record> written_in;
+    std::thread reader([&] {
+        for (long i = 0; i < records; ++i) {
+            record r;
+            r.sequence = i;
+            r.line = read_line(i);
+            parsed_in.push(std::move(r));
+        }
+        for (unsigned w = 0; w < workers; ++w) {
+            record stop;
+            stop.sequence = -1;
+            parsed_in.push(std::move(stop));
+        }
+    });
+    std::vector<std::thread> pool;
+    for (unsigned w = 0; w < workers; ++w) {
+        pool.emplace_back([&] {
+            for (;;) {
+                record r;
+                parsed_in.wait_and_pop(r);
+                if (r.sequence < 0) {
+                    return;
+                }
+                r.values = parse(r.line);
+                r.digest = transform(r.values);
+                written_in.push(std::move(r));
+            }
+        });
+    }
+    uint64_t checksum = 0;
+    std::map<long, uint64_t> reorder;
+    for (long next = 0; next < records;) {
+        record r;
+        written_in.wait_and_pop(r);
+        reorder.emplace(r.sequence, r.digest);
+        for (auto it = reorder.begin(); it != reorder.end() && it->first == next; it = reorder.erase(it), ++next) {
+            write(checksum, it->second);
+        }
+    }
+    reader.join();
+    for (auto &t: pool) {
+        t.join();
+    }
+    return checksum;
+}
+
+template<typename F>
+static void run(const std::string &name, F f) {
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t checksum = f();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << static_cast<long>(records / seconds) << " records/s (checksum " << checksum << ")"
+              << std::endl;
+}
+
+int main() {
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    thread_pool pool;
+    for (int round = 0; round < 3; ++round) {
+        for (size_t tokens: {threads * 1, threads * 4}) {
+            run("parallel_pipeline, " + std::to_string(tokens) + " tokens", [&] { return run_pipeline(pool, tokens); });
+        }
+        run("hand-wired queues, " + std::to_string(threads) + " workers", [&] { return run_queues(threads); });
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "utils/strand.h"
+#include "utils/thread_pool.h"
+
+// Serialised updates to many objects: a mutex per object with plain pool
+// tasks, against a strand per object. Most updates go to a few hot objects.
+struct object {
+    std::mutex mutex;
+    std::unique_ptr<strand> serial;
+    long long value = 0;
+};
+
+template<typename Post>
+static void run(const char *name, int ops, std::atomic<int> &done, Post post) {
+    done = 0;
+    const auto start = std::chrono::steady_clock::now();
+    post();
+    while (done.load(std::memory_order_acquire) < ops) {
+        std::this_thread::yield();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / ops
+              << " ns/update" << std::endl;
+}
+
+int main() {
+    thread_pool pool;
+    constexpr int object_count = 4096;
+    constexpr int ops = 1000000;
+    std::vector<object> objects(object_count);
+    for (auto &o: objects) {
+        o.serial = std::make_unique<strand>(pool);
+    }
+    std::mt19937 rng(42);
+    std::vector<int> targets(ops);
+    for (auto &t: targets) {
+        t = rng() % 4 == 0 ? static_cast<int>(rng() % object_count) : static_cast<int>(rng() % 8);
+    }
+
+    std::atomic<int> done{0};
+    for (int round = 0; round < 3; ++round) {
+        run("mutex + execute", ops, done, [&] {
+            for (int t: targets) {
+                pool.execute([&o = objects[t], &done] {
+                    std::lock_guard lock(o.mutex);
+                    ++o.value;
+                    done.fetch_add(1, std::memory_order_release);
+                });
+            }
+        });
+        run("strand         ", ops, done, [&] {
+            for (int t: targets) {
+                object &o = objects[t];
+                o.serial->post([&o, &done] {
+                    ++o.value;
+                    done.fetch_add(1, std::memory_order_release);
+                });
+            }
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "utils/thread_pool.h"
+
+// Count every heap allocation in the process, from any thread.
+std::atomic<long> allocations{0};
+
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+template<typename F>
+void run(const char *name, thread_pool &pool, long tasks, F make_task) {
+    std::vector<decltype(pool.submit(make_task(0)))> futures;
+    futures.reserve(tasks);
+
+    long alloc_start = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < tasks; ++i) {
+        futures.push_back(pool.submit(make_task(i)));
+    }
+    long sum = 0;
+    for (auto &f: futures) {
+        sum += f.get();
+    }
+    auto end = std::chrono::steady_clock::now();
+    long allocs = allocations.load() - alloc_start;
+
+    std::cout << name << ": " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / tasks
+              << " ns/task, " << static_cast<double>(allocs) / tasks << " allocations/task (checksum " << sum << ")"
+              << std::endl;
+}
+
+int main() {
+    const long tasks = 200000;
+    thread_pool pool;
+
+    run("small callable (8 bytes)", pool, tasks, [](long i) { return [i] { return i; }; });
+    run("medium callable (48 bytes)", pool, tasks, [](long i) {
+        return [a = i, b = i, c = i, d = i, e = i, g = i] { return a + b + c + d + e + g; };
+    });
+    run("large callable (256 bytes)", pool, tasks, [](long i) {
+        std::array<long, 32> data{};
+        data[0] = i;
+        return [data] { return data[0]; };
+    });
+    return 0;
+}
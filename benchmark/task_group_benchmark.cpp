@@ -0,0 +1,55 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <chrono>
+#include <iostream>
+
+#include "utils/task_group.h"
+#include "utils/thread_pool.h"
+
+// Recursive fib with a fork at every level above the cutoff: children as
+// task_group members versus one submitted task_future per child.
+static constexpr int cutoff = 4;
+
+static long long fib_serial(int n) { return n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2); }
+
+static long long fib_group(thread_pool &pool, int n) {
+    if (n < cutoff) {
+        return fib_serial(n);
+    }
+    long long a = 0;
+    task_group group(pool);
+    group.run([&] { a = fib_group(pool, n - 1); });
+    const long long b = fib_group(pool, n - 2);
+    group.wait();
+    return a + b;
+}
+
+static long long fib_future(thread_pool &pool, int n) {
+    if (n < cutoff) {
+        return fib_serial(n);
+    }
+    auto a = pool.submit([&pool, n] { return fib_future(pool, n - 1); });
+    const long long b = fib_future(pool, n - 2);
+    pool.wait_and_help(a);
+    return a.get() + b;
+}
+
+template<typename F>
+static void run(const char *name, thread_pool &pool, int n, F fib) {
+    const auto start = std::chrono::steady_clock::now();
+    const long long result = pool.submit([&] { return fib(pool, n); }).get();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": fib(" << n << ")=" << result << " in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms" << std::endl;
+}
+
+int main() {
+    thread_pool pool;
+    constexpr int n = 27;
+    for (int round = 0; round < 3; ++round) {
+        run("task_group ", pool, n, fib_group);
+        run("task_future", pool, n, fib_future);
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "utils/thread_pool.h"
+
+// Cost of arming and cancelling many pending timers, and how late short
+// timers fire while that many others are pending.
+int main() {
+    thread_pool pool;
+    constexpr int count = 500000;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> delay_ms(1000, 3600 * 1000);
+
+    std::vector<timer_id> ids;
+    ids.reserve(count);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        ids.push_back(pool.schedule_after(std::chrono::milliseconds(delay_ms(rng)), [] {}));
+    }
+    auto armed = std::chrono::steady_clock::now();
+
+    std::atomic<long long> lateness{0};
+    std::atomic<int> fired{0};
+    constexpr int probes = 100;
+    for (int i = 0; i < probes; ++i) {
+        const auto due = std::chrono::steady_clock::now() + std::chrono::milliseconds(5 + i);
+        pool.schedule_after(due - std::chrono::steady_clock::now(), [&, due] {
+            lateness += (std::chrono::steady_clock::now() - due).count();
+            ++fired;
+        });
+    }
+    while (fired < probes) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto cancel_start = std::chrono::steady_clock::now();
+    for (auto id: ids) {
+        pool.cancel_timer(id);
+    }
+    auto cancelled = std::chrono::steady_clock::now();
+
+    using ns = std::chrono::nanoseconds;
+    std::cout << count << " pending timers: "
+              << std::chrono::duration_cast<ns>(armed - start).count() / count << " ns/insert, "
+              << std::chrono::duration_cast<ns>(cancelled - cancel_start).count() / count << " ns/cancel, "
+              << "short timers fired " << lateness / probes / 1000 << " us late on average" << std::endl;
+    return 0;
+}
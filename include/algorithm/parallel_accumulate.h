@@ -5,34 +5,62 @@
 #ifndef CPP_CONCURRENCY_PARALLEL_ACCUMULATE_H
 #define CPP_CONCURRENCY_PARALLEL_ACCUMULATE_H
 
-#include <future>
 #include <algorithm>
 #include <numeric>
 
 #include "utils/thread_pool.h"
 
+// Sums each block on the pool and combines the partial sums pairwise with
+// continuations, so nothing blocks until the caller asks for the result.
 template<typename Iterator, typename T>
-T parallel_accumulate(Iterator first, Iterator last, T init) {
+task_future<T> parallel_accumulate_async(thread_pool &pool, Iterator first, Iterator last, T init) {
     const auto length = std::distance(first, last);
-    if (!length) {
-        return init;
-    }
     const long block_size = 25;
     auto num_blocks = (length + block_size - 1) / block_size;
-    std::vector<std::future<T>> futures(num_blocks - 1);
-    thread_pool pool;
+    std::vector<task_future<T>> level;
+    level.reserve(num_blocks + 1);
+    level.push_back(pool.submit([init] { return init; }));
     Iterator block_start = first;
-    for (long i = 0; i < (num_blocks - 1); ++i) {
+    for (long i = 0; i < num_blocks; ++i) {
         Iterator block_end = block_start;
-        std::advance(block_end, block_size);
-        futures[i] = pool.submit([=]{return std::accumulate(block_start, block_end, 0);});
+        std::advance(block_end, std::min<long>(block_size, std::distance(block_start, last)));
+        level.push_back(pool.submit([=] { return std::accumulate(block_start, block_end, T()); }));
         block_start = block_end;
     }
-    T result = std::accumulate(block_start, last, init);
-    for (long i = 0; i < (num_blocks - 1); ++i) {
-        result += futures[i].get();
+    while (level.size() > 1) {
+        std::vector<task_future<T>> next;
+        next.reserve((level.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < level.size(); i += 2) {
+            std::vector<task_future<T>> pair;
+            pair.push_back(std::move(level[i]));
+            pair.push_back(std::move(level[i + 1]));
+            next.push_back(when_all(std::move(pair)).then(pool, [](std::vector<T> sums) { return sums[0] + sums[1]; }));
+        }
+        if (level.size() % 2) {
+            next.push_back(std::move(level.back()));
+        }
+        level = std::move(next);
     }
-    return result;
+    return std::move(level.front());
+}
+
+template<typename Iterator, typename T>
+T parallel_accumulate(thread_pool &pool, Iterator first, Iterator last, T init) {
+    if (first == last) {
+        return init;
+    }
+    task_future<T> sum = parallel_accumulate_async(pool, first, last, init);
+    // A worker of the pool must keep it going: the blocks may sit on its own deque.
+    if (thread_pool::current() == &pool) {
+        pool.wait_and_help(sum);
+    }
+    return sum.get();
+}
+
+// Runs on the pool of the calling worker, or on thread_pool::default_pool().
+template<typename Iterator, typename T>
+T parallel_accumulate(Iterator first, Iterator last, T init) {
+    return parallel_accumulate(thread_pool::current_or_default(), first, last, init);
 }
 
 #endif //CPP_CONCURRENCY_PARALLEL_ACCUMULATE_H
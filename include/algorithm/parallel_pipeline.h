@@ -0,0 +1,343 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_PARALLEL_PIPELINE_H
+#define CPP_CONCURRENCY_PARALLEL_PIPELINE_H
+
+#include <any>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "utils/thread_pool.h"
+
+// How a pipeline stage may run:
+//   serial_in_order     - one item at a time, in the order the input made them
+//   serial_out_of_order - one item at a time, in any order
+//   parallel            - any number of items at once
+enum class filter_mode { serial_in_order, serial_out_of_order, parallel };
+
+// Handed to the input filter; calling stop() ends the stream, and whatever
+// the filter returns on that call is discarded.
+class flow_control {
+private:
+    bool stopped = false;
+
+public:
+    void stop() { stopped = true; }
+
+    bool is_stopped() const { return stopped; }
+};
+
+// One stage, with its item type erased. The body turns the item held in the
+// std::any into the next stage's input (or consumes it, for the last stage).
+struct pipeline_stage {
+    filter_mode mode;
+    std::function<void(std::any &, flow_control &)> body;
+};
+
+// A chain of stages taking In and producing Out; void at the ends. Build one
+// with make_filter and join them with &.
+template<typename In, typename Out>
+class filter {
+private:
+    template<typename, typename>
+    friend class filter;
+
+    template<typename A, typename B, typename C>
+    friend filter<A, C> operator&(const filter<A, B> &, const filter<B, C> &);
+
+    friend void parallel_pipeline(thread_pool &, size_t, const filter<void, void> &);
+
+    std::vector<pipeline_stage> stages;
+
+    filter() = default;
+
+public:
+    // f is Out(flow_control &) for the input stage, Out(In) otherwise
+    // (returning void for the last stage).
+    template<typename F>
+    filter(filter_mode mode, F f) {
+        std::function<void(std::any &, flow_control &)> body;
+        if constexpr (std::is_void_v<In>) {
+            body = [f = std::move(f)](std::any &item, flow_control &flow) mutable {
+                if constexpr (std::is_void_v<Out>) {
+                    f(flow);
+                } else {
+                    Out out = f(flow);
+                    if (!flow.is_stopped()) {
+                        item = std::move(out);
+                    }
+                }
+            };
+        } else {
+            body = [f = std::move(f)](std::any &item, flow_control &) mutable {
+                In in = std::move(*std::any_cast<In>(&item));
+                if constexpr (std::is_void_v<Out>) {
+                    item.reset();
+                    f(std::move(in));
+                } else {
+                    item = Out(f(std::move(in)));
+                }
+            };
+        }
+        stages.push_back(pipeline_stage{mode, std::move(body)});
+    }
+};
+
+template<typename In, typename Out, typename F>
+filter<In, Out> make_filter(filter_mode mode, F &&f) {
+    return filter<In, Out>(mode, std::forward<F>(f));
+}
+
+template<typename A, typename B, typename C>
+filter<A, C> operator&(const filter<A, B> &first, const filter<B, C> &second) {
+    filter<A, C> result;
+    result.stages = first.stages;
+    result.stages.insert(result.stages.end(), second.stages.begin(), second.stages.end());
+    return result;
+}
+
+// State of one parallel_pipeline call, shared by its tasks.
+class pipeline_run : public std::enable_shared_from_this<pipeline_run> {
+public:
+    struct token {
+        uint64_t sequence = 0;
+        std::any item;
+    };
+
+private:
+    // Admission to a serial stage. An item that finds the stage busy, or
+    // arrives ahead of its turn, is parked here; the item leaving the stage
+    // hands the stage to the next parked one.
+    struct serial_gate {
+        std::mutex mutex;
+        bool busy = false;
+        uint64_t next_sequence = 0;
+        std::map<uint64_t, token> waiting_in_order;
+        std::deque<token> waiting;
+    };
+
+    thread_pool &pool;
+    // A copy: a task dropped by shutdown(cancel) opens `finished` while
+    // others may still be running.
+    const std::vector<pipeline_stage> stages;
+    std::vector<std::unique_ptr<serial_gate>> gates;
+
+    // Input side, under input_mutex: free tokens, and whether an input task
+    // is queued or running, or stopped for lack of tokens, or done for good.
+    std::mutex input_mutex;
+    size_t free_tokens;
+    const size_t max_tokens;
+    uint64_t next_sequence = 0;
+    bool input_active = false;
+    bool input_parked = false;
+    bool input_done = false;
+
+public:
+    // Opens when the input is exhausted and every item has left the pipeline;
+    // holds the first exception.
+    countdown_latch finished{1};
+
+    pipeline_run(thread_pool &pool_, const std::vector<pipeline_stage> &stages_, size_t max_tokens_)
+        : pool(pool_), stages(stages_), free_tokens(max_tokens_), max_tokens(max_tokens_) {
+        for (const auto &stage: stages) {
+            gates.push_back(stage.mode == filter_mode::parallel ? nullptr : std::make_unique<serial_gate>());
+        }
+    }
+
+    // Runs a task that holds the pipeline alive; if the pool drops it
+    // (shutdown(cancel)), finished opens with task_cancelled. The overflow
+    // policy of a bounded pool does not apply: a dropped task would lose its
+    // token, and one run on the caller would take input_mutex twice.
+    template<typename F>
+    void spawn(F &&f) {
+        std::shared_ptr<countdown_latch> latch(shared_from_this(), &finished);
+        pool.post_internal(function_wapper([guard = latch_guard(std::move(latch)), this,
+                                            f = std::forward<F>(f)]() mutable {
+            guard.disarm();
+            f();
+        }));
+    }
+
+    void start() {
+        std::lock_guard lock(input_mutex);
+        input_active = true;
+        --free_tokens;
+        spawn([this] { run_input(); });
+    }
+
+    // Makes one item, keeps the input going on another task while tokens
+    // last, and carries the item on down the pipeline itself.
+    void run_input() {
+        token t;
+        bool stop = finished.failed();
+        if (!stop) {
+            flow_control flow;
+            try {
+                stages[0].body(t.item, flow);
+            } catch (...) {
+                finished.set_exception(std::current_exception());
+            }
+            stop = flow.is_stopped() || finished.failed();
+        }
+        {
+            std::lock_guard lock(input_mutex);
+            if (stop) {
+                // The token taken for this item goes back unused.
+                ++free_tokens;
+                input_active = false;
+                input_done = true;
+                check_finished();
+                return;
+            }
+            t.sequence = next_sequence++;
+            if (free_tokens > 0) {
+                --free_tokens;
+                spawn([this] { run_input(); });
+            } else {
+                input_active = false;
+                input_parked = true;
+            }
+        }
+        // The input stage is serial; pass its ordering on to the next stage.
+        carry(1, std::move(t));
+    }
+
+    // Take t through stages from index `stage` on, on this thread, until it
+    // leaves the pipeline or has to wait for a serial stage.
+    void carry(size_t stage, token t) {
+        for (; stage < stages.size(); ++stage) {
+            serial_gate *gate = gates[stage].get();
+            if (gate && !enter(*gate, stages[stage].mode, t)) {
+                return;
+            }
+            run_stage(stage, t);
+            if (gate) {
+                leave(stage, *gate);
+            }
+        }
+        release_token();
+    }
+
+    void run_stage(size_t stage, token &t) {
+        // After a failure items still pass through, so ordered stages see
+        // every sequence number, but no more user code runs.
+        if (finished.failed()) {
+            t.item.reset();
+            return;
+        }
+        try {
+            flow_control flow;
+            stages[stage].body(t.item, flow);
+        } catch (...) {
+            finished.set_exception(std::current_exception());
+            t.item.reset();
+        }
+    }
+
+    bool enter(serial_gate &gate, filter_mode mode, token &t) {
+        std::lock_guard lock(gate.mutex);
+        if (mode == filter_mode::serial_in_order) {
+            if (!gate.busy && t.sequence == gate.next_sequence) {
+                gate.busy = true;
+                return true;
+            }
+            gate.waiting_in_order.emplace(t.sequence, std::move(t));
+            return false;
+        }
+        if (!gate.busy) {
+            gate.busy = true;
+            return true;
+        }
+        gate.waiting.push_back(std::move(t));
+        return false;
+    }
+
+    // The stage stays busy if a parked item can take it over; that item then
+    // runs it on a new task while this thread carries its own item on.
+    void leave(size_t stage, serial_gate &gate) {
+        token next;
+        {
+            std::lock_guard lock(gate.mutex);
+            if (stages[stage].mode == filter_mode::serial_in_order) {
+                ++gate.next_sequence;
+                auto it = gate.waiting_in_order.find(gate.next_sequence);
+                if (it == gate.waiting_in_order.end()) {
+                    gate.busy = false;
+                    return;
+                }
+                next = std::move(it->second);
+                gate.waiting_in_order.erase(it);
+            } else {
+                if (gate.waiting.empty()) {
+                    gate.busy = false;
+                    return;
+                }
+                next = std::move(gate.waiting.front());
+                gate.waiting.pop_front();
+            }
+        }
+        spawn([this, stage, next = std::move(next)]() mutable {
+            run_stage(stage, next);
+            leave(stage, *gates[stage]);
+            carry(stage + 1, std::move(next));
+        });
+    }
+
+    void release_token() {
+        std::lock_guard lock(input_mutex);
+        ++free_tokens;
+        if (input_parked) {
+            input_parked = false;
+            input_active = true;
+            --free_tokens;
+            spawn([this] { run_input(); });
+            return;
+        }
+        check_finished();
+    }
+
+    // Under input_mutex.
+    void check_finished() {
+        if (input_done && !input_active && free_tokens == max_tokens) {
+            finished.count_down();
+        }
+    }
+};
+
+// Runs the chain of filters until the input filter calls flow_control::stop.
+// At most max_tokens items are in flight at once. A task carries each item
+// through as many stages as it can, so the item stays in one core's cache; it
+// hands off only where a serial stage is busy or the item must wait its turn.
+//
+// Returns when every item has left the pipeline. The first exception from a
+// filter stops the input and is rethrown here; items already in flight skip
+// the remaining filters. Called from a worker, the caller runs queued work
+// while it waits.
+inline void parallel_pipeline(thread_pool &pool, size_t max_tokens, const filter<void, void> &chain) {
+    if (max_tokens == 0) {
+        throw std::invalid_argument("parallel_pipeline: max_tokens must be at least 1");
+    }
+    if (chain.stages.empty()) {
+        return;
+    }
+    if (chain.stages[0].mode == filter_mode::parallel) {
+        throw std::invalid_argument("parallel_pipeline: the input filter must be serial");
+    }
+    auto run = std::make_shared<pipeline_run>(pool, chain.stages, max_tokens);
+    run->start();
+    pool.wait_and_help(run->finished);
+}
+
+#endif //CPP_CONCURRENCY_PARALLEL_PIPELINE_H
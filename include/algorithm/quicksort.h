@@ -6,47 +6,59 @@
 #define CPP_CONCURRENCY_QUICKSORT_H
 
 #include <algorithm>
-#include <chrono>
 #include <functional>
-#include <future>
 #include <list>
 #include <numeric>
 
+#include "utils/task_group.h"
 #include "utils/thread_pool.h"
 
 template <typename T>
 struct sorter {
-  thread_pool pool;
+  // Below this size a chunk is sorted in place: spawning a task costs more than
+  // the sort, and every spawned task can add a nested frame to a waiting thread.
+  static constexpr size_t sequential_cutoff = 256;
+
+  thread_pool &pool;
 
   std::list<T> do_sort(std::list<T> &chunk_data) {
-    if (chunk_data.empty()) {
-      return chunk_data;
+    if (chunk_data.size() <= sequential_cutoff) {
+      chunk_data.sort();
+      return std::move(chunk_data);
     }
     std::list<T> result;
-    result.splice(result.begin(), chunk_data, chunk_data.begin());
+    // Take the pivot from the middle so already sorted or reversed input does
+    // not degrade into one level of recursion (and one nested task) per element.
+    result.splice(result.begin(), chunk_data, std::next(chunk_data.begin(), chunk_data.size() / 2));
     T const &partition_val = *result.begin();
     auto divide_point =
         std::partition(chunk_data.begin(), chunk_data.end(), [&](T const &val) { return val < partition_val; });
     std::list<T> new_lower_chunk;
     new_lower_chunk.splice(new_lower_chunk.begin(), chunk_data, chunk_data.begin(), divide_point);
-    std::future<std::list<T>> new_lower = pool.submit(&sorter::do_sort, this, std::move(new_lower_chunk));
+    std::list<T> new_lower;
+    task_group group(pool);
+    group.run([&] { new_lower = do_sort(new_lower_chunk); });
     std::list<T> new_higher(do_sort(chunk_data));
     result.splice(result.end(), new_higher);
-    while (new_lower.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) {
-      pool.run_pending_task();
-    }
-    result.splice(result.begin(), new_lower.get());
+    group.wait();
+    result.splice(result.begin(), new_lower);
     return result;
   }
 };
 
 template <typename T>
-std::list<T> parallel_quick_sort(std::list<T> input) {
+std::list<T> parallel_quick_sort(thread_pool &pool, std::list<T> input) {
   if (input.empty()) {
     return input;
   }
-  sorter<T> s;
+  sorter<T> s{pool};
   return s.do_sort(input);
-};
+}
+
+// Runs on the pool of the calling worker, or on thread_pool::default_pool().
+template <typename T>
+std::list<T> parallel_quick_sort(std::list<T> input) {
+  return parallel_quick_sort(thread_pool::current_or_default(), std::move(input));
+}
 
 #endif  // CPP_CONCURRENCY_QUICKSORT_H
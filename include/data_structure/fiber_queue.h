@@ -0,0 +1,76 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_FIBER_QUEUE_H
+#define CPP_CONCURRENCY_FIBER_QUEUE_H
+
+#include <memory>
+#include <mutex>
+#include <queue>
+
+#include "utils/fiber.h"
+
+// threadsafe_queue whose wait_and_pop suspends a calling fiber instead of
+// blocking its worker; plain threads block as usual.
+template<typename T>
+class fiber_queue {
+private:
+    mutable std::mutex mut;
+    std::queue<T> data_queue;
+    fiber_wait_queue waiters;
+
+public:
+    fiber_queue() = default;
+
+    fiber_queue(const fiber_queue &) = delete;
+
+    fiber_queue &operator=(const fiber_queue &) = delete;
+
+    void push(T new_value) {
+        fiber_wake_list woken;
+        std::lock_guard lock(mut);
+        data_queue.push(std::move(new_value));
+        waiters.notify_one(woken);
+    }
+
+    void wait_and_pop(T &value) {
+        std::unique_lock lock(mut);
+        waiters.wait(lock, [this] { return !data_queue.empty(); });
+        value = std::move(data_queue.front());
+        data_queue.pop();
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        std::unique_lock lock(mut);
+        waiters.wait(lock, [this] { return !data_queue.empty(); });
+        std::shared_ptr<T> res(std::make_shared<T>(std::move(data_queue.front())));
+        data_queue.pop();
+        return res;
+    }
+
+    bool try_pop(T &value) {
+        std::lock_guard lock(mut);
+        if (data_queue.empty())
+            return false;
+        value = std::move(data_queue.front());
+        data_queue.pop();
+        return true;
+    }
+
+    std::shared_ptr<T> try_pop() {
+        std::lock_guard lock(mut);
+        if (data_queue.empty())
+            return std::shared_ptr<T>{};
+        std::shared_ptr<T> res(std::make_shared<T>(std::move(data_queue.front())));
+        data_queue.pop();
+        return res;
+    }
+
+    bool empty() const {
+        std::lock_guard lock(mut);
+        return data_queue.empty();
+    }
+};
+
+#endif //CPP_CONCURRENCY_FIBER_QUEUE_H
@@ -0,0 +1,83 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_MPSC_QUEUE_H
+#define CPP_CONCURRENCY_MPSC_QUEUE_H
+
+#include <atomic>
+#include <thread>
+
+// Base of every node an intrusive_mpsc_queue links; derive to add a payload.
+struct mpsc_node {
+    std::atomic<mpsc_node *> next{nullptr};
+};
+
+// Vyukov's intrusive multi-producer single-consumer queue. Producers swap
+// their node in at head with one exchange and never wait; the one consumer
+// walks from tail. The queue does not own nodes and never allocates: a stub
+// node keeps the list non-empty. FIFO per producer.
+class intrusive_mpsc_queue {
+private:
+    std::atomic<mpsc_node *> head;
+    mpsc_node *tail;
+    mpsc_node stub;
+
+    // Between a producer's exchange and its link the list is briefly cut;
+    // wait it out rather than report a queued node as missing.
+    mpsc_node *next_of(mpsc_node *n) const {
+        mpsc_node *next = n->next.load(std::memory_order_acquire);
+        while (next == nullptr && head.load(std::memory_order_acquire) != n) {
+            std::this_thread::yield();
+            next = n->next.load(std::memory_order_acquire);
+        }
+        return next;
+    }
+
+public:
+    intrusive_mpsc_queue() : head(&stub), tail(&stub) {}
+
+    intrusive_mpsc_queue(const intrusive_mpsc_queue &) = delete;
+
+    intrusive_mpsc_queue &operator=(const intrusive_mpsc_queue &) = delete;
+
+    // Any thread. seq_cst, so a producer that pushes and then checks a flag
+    // pairs with a consumer that clears the flag and then checks empty().
+    void push(mpsc_node *n) {
+        n->next.store(nullptr, std::memory_order_relaxed);
+        mpsc_node *prev = head.exchange(n, std::memory_order_seq_cst);
+        prev->next.store(n, std::memory_order_release);
+    }
+
+    // Consumer only; nullptr when empty.
+    mpsc_node *pop() {
+        mpsc_node *t = tail;
+        mpsc_node *next = next_of(t);
+        if (t == &stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail = next;
+            t = next;
+            next = next_of(t);
+        }
+        if (next == nullptr) {
+            // t is the last node; put the stub behind it so t can leave.
+            push(&stub);
+            next = next_of(t);
+        }
+        tail = next;
+        return t;
+    }
+
+    // Consumer only. tail is the next node to hand out, or the stub once
+    // everything has been handed out.
+    bool empty() const { return tail == &stub && head.load(std::memory_order_seq_cst) == &stub; }
+
+    // For a consumer that found the queue empty and then gave up its role:
+    // true if nothing was pushed since. Reads only head, so it stays safe
+    // while a new consumer is already popping and moving tail.
+    bool drained() const { return head.load(std::memory_order_seq_cst) == &stub; }
+};
+
+#endif //CPP_CONCURRENCY_MPSC_QUEUE_H
@@ -213,6 +213,33 @@ public:
         return !!old_head;
     }
 
+    // Pops up to max_count values into out under one head lock (and one tail
+    // lock); the values are moved out after the lock is released. Returns how
+    // many were popped.
+    template<typename OutputIterator>
+    size_t try_pop_batch(OutputIterator out, size_t max_count) {
+        std::unique_ptr<node> chain;
+        size_t count = 0;
+        {
+            std::lock_guard head_lock(head_mutex);
+            node *const current_tail = get_tail();
+            node *last = nullptr;
+            for (node *n = head.get(); n != current_tail && count < max_count; n = n->next.get()) {
+                last = n;
+                ++count;
+            }
+            if (count == 0) {
+                return 0;
+            }
+            chain = std::move(head);
+            head = std::move(last->next);
+        }
+        for (node *n = chain.get(); n; n = n->next.get()) {
+            *out++ = std::move(*n->data);
+        }
+        return count;
+    }
+
     std::shared_ptr<T> wait_and_pop() {
         std::unique_ptr<node> const old_head = wait_pop_head();
         return old_head->data;
@@ -234,6 +261,30 @@ public:
         data_cond.notify_one();
     }
 
+    // Moves [first, last) in with a single tail lock acquisition: the chain of
+    // nodes is built outside the lock and spliced on in one step.
+    template<typename Iterator>
+    void push_batch(Iterator first, Iterator last) {
+        if (first == last) {
+            return;
+        }
+        std::shared_ptr<T> first_data = std::make_shared<T>(std::move(*first));
+        std::unique_ptr<node> chain = std::make_unique<node>();
+        node *chain_tail = chain.get();
+        for (++first; first != last; ++first) {
+            chain_tail->data = std::make_shared<T>(std::move(*first));
+            chain_tail->next = std::make_unique<node>();
+            chain_tail = chain_tail->next.get();
+        }
+        {
+            std::lock_guard lk(tail_mutex);
+            tail->data = first_data;
+            tail->next = std::move(chain);
+            tail = chain_tail;
+        }
+        data_cond.notify_all();
+    }
+
     bool empty() {
         std::lock_guard head_lock(head_mutex);
         return head.get() == get_tail();
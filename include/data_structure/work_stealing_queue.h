@@ -0,0 +1,102 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_WORK_STEALING_QUEUE_H
+#define CPP_CONCURRENCY_WORK_STEALING_QUEUE_H
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Per-worker deque: the owner pushes and pops at the front (LIFO, keeps the
+// most recently spawned and cache-hot work local), thieves take from the back
+// (FIFO, the oldest and usually largest pieces of work).
+//
+// Stored in a ring that only ever grows, so a worker that keeps pushing and
+// popping one task at a time never allocates (a std::deque frees and
+// reallocates a block whenever it runs empty at a block edge).
+template<typename T>
+class work_stealing_queue {
+private:
+    std::vector<T> ring;
+    // Index of the front element; size elements follow it, wrapping around.
+    size_t head = 0;
+    size_t count = 0;
+    mutable std::mutex the_mutex;
+
+    size_t wrap(size_t i) const { return i & (ring.size() - 1); }
+
+    void grow() {
+        std::vector<T> bigger(ring.empty() ? 16 : ring.size() * 2);
+        for (size_t i = 0; i < count; ++i) {
+            bigger[i] = std::move(ring[wrap(head + i)]);
+        }
+        ring.swap(bigger);
+        head = 0;
+    }
+
+    void push_front_locked(T data) {
+        if (count == ring.size()) {
+            grow();
+        }
+        head = wrap(head + ring.size() - 1);
+        ring[head] = std::move(data);
+        ++count;
+    }
+
+public:
+    work_stealing_queue() {}
+
+    work_stealing_queue(const work_stealing_queue &other) = delete;
+
+    work_stealing_queue &operator=(const work_stealing_queue &other) = delete;
+
+    void push(T data) {
+        std::lock_guard lock(the_mutex);
+        push_front_locked(std::move(data));
+    }
+
+    // Pushed back to front so the owner pops the batch in its original order.
+    template<typename BidirectionalIterator>
+    void push_batch(BidirectionalIterator first, BidirectionalIterator last) {
+        std::lock_guard lock(the_mutex);
+        while (last != first) {
+            push_front_locked(std::move(*--last));
+        }
+    }
+
+    bool empty() const {
+        std::lock_guard lock(the_mutex);
+        return count == 0;
+    }
+
+    size_t size() const {
+        std::lock_guard lock(the_mutex);
+        return count;
+    }
+
+    bool try_pop(T &res) {
+        std::lock_guard lock(the_mutex);
+        if (count == 0) {
+            return false;
+        }
+        res = std::move(ring[head]);
+        head = wrap(head + 1);
+        --count;
+        return true;
+    }
+
+    bool try_steal(T &res) {
+        std::lock_guard lock(the_mutex);
+        if (count == 0) {
+            return false;
+        }
+        --count;
+        res = std::move(ring[wrap(head + count)]);
+        return true;
+    }
+};
+
+#endif //CPP_CONCURRENCY_WORK_STEALING_QUEUE_H
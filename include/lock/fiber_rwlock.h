@@ -0,0 +1,59 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_FIBER_RWLOCK_H
+#define CPP_CONCURRENCY_FIBER_RWLOCK_H
+
+#include <mutex>
+
+#include "utils/fiber.h"
+
+// rwlock whose waits suspend a calling fiber instead of blocking its worker.
+// A waiting writer holds back new readers, so writers cannot starve.
+class fiber_rwlock {
+private:
+    int readers = 0;
+    int waiting_writers = 0;
+    bool has_writer = false;
+    std::mutex m;
+    fiber_wait_queue reader_waiters;
+    fiber_wait_queue writer_waiters;
+
+public:
+    void RLock() {
+        std::unique_lock lk(m);
+        reader_waiters.wait(lk, [&]() { return !has_writer && waiting_writers == 0; });
+        readers++;
+    }
+
+    void WLock() {
+        std::unique_lock lk(m);
+        waiting_writers++;
+        writer_waiters.wait(lk, [&]() { return !has_writer && readers == 0; });
+        waiting_writers--;
+        has_writer = true;
+    }
+
+    void RUnLock() {
+        fiber_wake_list woken;
+        std::lock_guard lk(m);
+        readers--;
+        if (readers == 0) {
+            writer_waiters.notify_one(woken);
+        }
+    }
+
+    void WUnLock() {
+        fiber_wake_list woken;
+        std::lock_guard lk(m);
+        has_writer = false;
+        if (waiting_writers > 0) {
+            writer_waiters.notify_one(woken);
+        } else {
+            reader_waiters.notify_all(woken);
+        }
+    }
+};
+
+#endif //CPP_CONCURRENCY_FIBER_RWLOCK_H
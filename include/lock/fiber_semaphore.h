@@ -0,0 +1,46 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_FIBER_SEMAPHORE_H
+#define CPP_CONCURRENCY_FIBER_SEMAPHORE_H
+
+#include <mutex>
+
+#include "utils/fiber.h"
+
+// semaphore whose acquire() suspends a calling fiber instead of blocking its
+// worker; plain threads block as with semaphore.
+class fiber_semaphore {
+public:
+    fiber_semaphore(int cnt_ = 0) : cnt(cnt_) {}
+
+    void acquire() {
+        std::unique_lock lk(m);
+        waiters.wait(lk, [&]() { return cnt > 0; });
+        cnt--;
+    }
+
+    bool try_acquire() {
+        std::lock_guard lk(m);
+        if (cnt == 0) {
+            return false;
+        }
+        cnt--;
+        return true;
+    }
+
+    void release() {
+        fiber_wake_list woken;
+        std::lock_guard lk(m);
+        cnt++;
+        waiters.notify_one(woken);
+    }
+
+private:
+    int cnt;
+    std::mutex m;
+    fiber_wait_queue waiters;
+};
+
+#endif //CPP_CONCURRENCY_FIBER_SEMAPHORE_H
@@ -0,0 +1,107 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_ACTOR_H
+#define CPP_CONCURRENCY_ACTOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "thread_pool.h"
+#include "data_structure/mpsc_queue.h"
+
+// Message-driven object multiplexed on a thread_pool. Derive, implement
+// receive(), and create it with std::make_shared (scheduling keeps the actor
+// alive through shared_from_this). Messages are handled one at a time, in
+// send order per sender, so receive() can touch the actor's state without
+// locks; many actors share the pool's workers instead of a thread each.
+//
+// send() allocates the mailbox node and nothing else: a lock-free push onto
+// the actor's MPSC mailbox. Only the send that finds the actor idle puts it on
+// the pool. An activation handles at most `batch` messages, then requeues the
+// actor at low priority so a flooded actor cannot hog a worker. Activations
+// are never dropped or run on the sender by a bounded pool's overflow policy.
+//
+// receive() must not throw, as with thread_pool::execute.
+template<typename Message>
+class actor : public std::enable_shared_from_this<actor<Message>> {
+private:
+    struct node : mpsc_node {
+        Message message;
+
+        template<typename... Args>
+        explicit node(Args &&...args) : message(std::forward<Args>(args)...) {}
+    };
+
+    thread_pool &pool;
+    const size_t batch;
+    intrusive_mpsc_queue mailbox;
+    // Set by the send that finds the actor idle, cleared by the activation
+    // that drains the mailbox; whoever flips it to true schedules the actor.
+    std::atomic<bool> scheduled{false};
+
+    // Past a bounded pool's limit: a dropped activation would leave the
+    // actor marked scheduled with nobody to run it.
+    void activate(task_priority priority) {
+        pool.post_internal(function_wapper([self = this->shared_from_this()] { self->run(); }), priority);
+    }
+
+    void run() {
+        for (;;) {
+            for (size_t i = 0; i < batch; ++i) {
+                std::unique_ptr<node> n(static_cast<node *>(mailbox.pop()));
+                if (!n) {
+                    break;
+                }
+                receive(n->message);
+            }
+            if (!mailbox.empty()) {
+                // A normal task would land on this worker's deque and run next.
+                activate(task_priority::low);
+                return;
+            }
+            scheduled.store(false, std::memory_order_seq_cst);
+            // A send that saw scheduled still true relies on us to pick it up.
+            // A new activation may own the mailbox from here on; see strand.
+            if (mailbox.drained() || scheduled.exchange(true, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+    }
+
+protected:
+    // One message at a time, never concurrently with itself.
+    virtual void receive(Message &message) = 0;
+
+public:
+    static constexpr size_t default_batch = 64;
+
+    explicit actor(thread_pool &pool_, size_t batch_ = default_batch) : pool(pool_), batch(batch_ ? batch_ : 1) {}
+
+    actor(const actor &) = delete;
+
+    actor &operator=(const actor &) = delete;
+
+    // Messages still queued when the last reference goes are dropped.
+    virtual ~actor() {
+        while (mpsc_node *n = mailbox.pop()) {
+            delete static_cast<node *>(n);
+        }
+    }
+
+    // Any thread, including from inside receive().
+    template<typename... Args>
+    void send(Args &&...args) {
+        mailbox.push(new node(std::forward<Args>(args)...));
+        if (!scheduled.load(std::memory_order_seq_cst) && !scheduled.exchange(true, std::memory_order_acq_rel)) {
+            activate(task_priority::normal);
+        }
+    }
+
+    thread_pool &get_pool() const { return pool; }
+};
+
+#endif //CPP_CONCURRENCY_ACTOR_H
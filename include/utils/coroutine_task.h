@@ -0,0 +1,223 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_COROUTINE_TASK_H
+#define CPP_CONCURRENCY_COROUTINE_TASK_H
+
+#include "thread_pool.h"
+
+#if CPP_CONCURRENCY_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+template<typename T = void>
+class task;
+
+namespace detail {
+
+// When a task finishes, hand the thread straight to whoever awaited it
+// (symmetric transfer): if the task ran on a worker, so does the awaiter.
+struct final_awaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template<typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        if (auto continuation = handle.promise().continuation) {
+            return continuation;
+        }
+        return std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+};
+
+struct task_promise_base {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+
+    final_awaiter final_suspend() const noexcept { return {}; }
+
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+
+    void rethrow_if_failed() const {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+template<typename T>
+struct task_promise_type : task_promise_base {
+    std::optional<T> value;
+
+    task<T> get_return_object() noexcept;
+
+    template<typename U>
+    void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+
+    T result() {
+        rethrow_if_failed();
+        return std::move(*value);
+    }
+};
+
+template<>
+struct task_promise_type<void> : task_promise_base {
+    task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void result() const { rethrow_if_failed(); }
+};
+
+} // namespace detail
+
+// Lazily started coroutine: the body runs when the task is co_awaited (or
+// handed to sync_wait), and the awaiting coroutine resumes where the task ends.
+template<typename T>
+class task {
+public:
+    using promise_type = detail::task_promise_type<T>;
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+public:
+    explicit task(std::coroutine_handle<promise_type> handle_) noexcept : handle(handle_) {}
+
+    task(task &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+
+    task &operator=(task &&other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+
+    task(const task &) = delete;
+
+    task &operator=(const task &) = delete;
+
+    ~task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    struct awaiter {
+        std::coroutine_handle<promise_type> handle;
+
+        bool await_ready() const noexcept { return handle.done(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+
+        T await_resume() { return handle.promise().result(); }
+    };
+
+    awaiter operator co_await() const noexcept { return awaiter{handle}; }
+};
+
+namespace detail {
+
+template<typename T>
+task<T> task_promise_type<T>::get_return_object() noexcept {
+    return task<T>(std::coroutine_handle<task_promise_type<T>>::from_promise(*this));
+}
+
+inline task<void> task_promise_type<void>::get_return_object() noexcept {
+    return task<void>(std::coroutine_handle<task_promise_type<void>>::from_promise(*this));
+}
+
+// Eagerly started driver for sync_wait: completes a latch from its final suspend.
+struct sync_wait_driver {
+    struct promise_type {
+        countdown_latch *done = nullptr;
+
+        sync_wait_driver get_return_object() noexcept {
+            return sync_wait_driver{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+
+        auto final_suspend() const noexcept {
+            struct notify {
+                bool await_ready() const noexcept { return false; }
+
+                void await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+                    handle.promise().done->count_down();
+                }
+
+                void await_resume() const noexcept {}
+            };
+            return notify{};
+        }
+
+        void return_void() const noexcept {}
+
+        // The awaited task's errors are captured by the task itself.
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+    ~sync_wait_driver() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+};
+
+template<typename T>
+using sync_wait_storage = std::conditional_t<std::is_void_v<T>, std::optional<char>, std::optional<T>>;
+
+template<typename T>
+sync_wait_driver make_sync_wait_driver(task<T> &t, std::exception_ptr &error, sync_wait_storage<T> &out) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await t;
+            out.emplace();
+        } else {
+            out.emplace(co_await t);
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+}
+
+} // namespace detail
+
+// Block the calling (non-coroutine) thread until t has finished and return
+// its result. Typically t starts with co_await pool.schedule().
+template<typename T>
+T sync_wait(task<T> t) {
+    countdown_latch done(1);
+    std::exception_ptr error;
+    detail::sync_wait_storage<T> out;
+    detail::sync_wait_driver driver = detail::make_sync_wait_driver<T>(t, error, out);
+    driver.handle.promise().done = &done;
+    driver.handle.resume();
+    done.wait();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if constexpr (!std::is_void_v<T>) {
+        return std::move(*out);
+    }
+}
+
+#endif // CPP_CONCURRENCY_HAS_COROUTINES
+
+#endif //CPP_CONCURRENCY_COROUTINE_TASK_H
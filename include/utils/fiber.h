@@ -0,0 +1,589 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_FIBER_H
+#define CPP_CONCURRENCY_FIBER_H
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "task_future.h"
+#include "thread_pool.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#define FIBER_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define FIBER_ASAN 1
+#endif
+#endif
+
+#ifdef FIBER_ASAN
+#include <sanitizer/asan_interface.h>
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+// Define FIBER_USE_UCONTEXT to switch with swapcontext on x86-64 as well.
+// swapcontext saves and restores the signal mask, a syscall on every switch;
+// the hand-written switch only saves what the SysV ABI makes callee-saved.
+#if defined(__x86_64__) && !defined(FIBER_USE_UCONTEXT)
+#define FIBER_ASM_SWITCH 1
+#endif
+
+#ifdef FIBER_ASM_SWITCH
+// A suspended context is just its stack pointer; the registers it needs are
+// pushed on its own stack.
+struct fiber_context {
+    void *sp = nullptr;
+};
+
+extern "C" void fiber_switch_context(void **save_sp, void *next_sp);
+extern "C" void fiber_start_context();
+
+// Pushes the callee-saved registers, MXCSR and the x87 control word, swaps
+// stacks and pops the other side's. Weak, so every translation unit that
+// includes this header may emit it.
+asm(R"(
+    .text
+    .weak fiber_switch_context
+    .type fiber_switch_context, @function
+fiber_switch_context:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size fiber_switch_context, .-fiber_switch_context
+
+    .weak fiber_start_context
+    .type fiber_start_context, @function
+fiber_start_context:
+    movq %r12, %rdi
+    callq *%r13
+    ud2
+    .size fiber_start_context, .-fiber_start_context
+)");
+
+// The first switch to ctx pops a frame that "returns" into
+// fiber_start_context, which calls fn(arg). fn must never return.
+inline void fiber_context_make(fiber_context &ctx, void *bottom, size_t size, void (*fn)(void *), void *arg) {
+    auto top = (reinterpret_cast<uintptr_t>(bottom) + size) & ~static_cast<uintptr_t>(15);
+    auto *frame = reinterpret_cast<uint64_t *>(top) - 10;
+    uint32_t control[2] = {0x1f80, 0x037f};  // default MXCSR and x87 control word
+    std::memcpy(&frame[0], control, sizeof(control));
+    frame[1] = 0;                                      // r15
+    frame[2] = 0;                                      // r14
+    frame[3] = reinterpret_cast<uint64_t>(fn);         // r13
+    frame[4] = reinterpret_cast<uint64_t>(arg);        // r12
+    frame[5] = 0;                                      // rbx
+    frame[6] = 0;                                      // rbp
+    frame[7] = reinterpret_cast<uint64_t>(&fiber_start_context);
+    // fiber_start_context then starts with a 16-byte aligned stack, as after
+    // a call, so fn sees the alignment the ABI promises.
+    frame[8] = 0;
+    frame[9] = 0;
+    ctx.sp = frame;
+}
+
+inline void fiber_context_switch(fiber_context &from, fiber_context &to) { fiber_switch_context(&from.sp, to.sp); }
+#else
+struct fiber_context {
+    ucontext_t uc;
+};
+
+inline void fiber_context_entry(uint32_t fn_high, uint32_t fn_low, uint32_t arg_high, uint32_t arg_low) {
+    auto fn = reinterpret_cast<void (*)(void *)>((static_cast<uintptr_t>(fn_high) << 32) | fn_low);
+    fn(reinterpret_cast<void *>((static_cast<uintptr_t>(arg_high) << 32) | arg_low));
+}
+
+// makecontext only passes ints, so pointers go in halves.
+inline void fiber_context_make(fiber_context &ctx, void *bottom, size_t size, void (*fn)(void *), void *arg) {
+    getcontext(&ctx.uc);
+    ctx.uc.uc_stack.ss_sp = bottom;
+    ctx.uc.uc_stack.ss_size = size;
+    ctx.uc.uc_link = nullptr;
+    const auto f = reinterpret_cast<uintptr_t>(fn);
+    const auto a = reinterpret_cast<uintptr_t>(arg);
+    makecontext(&ctx.uc, reinterpret_cast<void (*)()>(&fiber_context_entry), 4, static_cast<uint32_t>(f >> 32),
+                static_cast<uint32_t>(f), static_cast<uint32_t>(a >> 32), static_cast<uint32_t>(a));
+}
+
+inline void fiber_context_switch(fiber_context &from, fiber_context &to) { swapcontext(&from.uc, &to.uc); }
+#endif
+
+// One fiber stack: an anonymous mapping whose lowest page is PROT_NONE, so
+// running off the end faults instead of overwriting the neighbouring stack.
+struct fiber_stack {
+    void *mapping = nullptr;
+    size_t mapping_size = 0;
+    // Usable part, above the guard page.
+    void *bottom = nullptr;
+    size_t size = 0;
+};
+
+// Recycles fiber stacks: mapping and unmapping a stack per fiber would cost
+// two syscalls and page faults on every spawn. Pages stay committed while a
+// stack is cached; at most max_cached stacks are kept.
+class fiber_stack_pool {
+private:
+    const size_t stack_size;
+    const size_t max_cached;
+    std::mutex mutex;
+    std::vector<fiber_stack> free_stacks;
+
+    static size_t page_size() {
+        static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+
+    static void unmap(const fiber_stack &stack) { munmap(stack.mapping, stack.mapping_size); }
+
+public:
+    static constexpr size_t default_stack_size = 64 * 1024;
+
+    explicit fiber_stack_pool(size_t stack_size_ = default_stack_size, size_t max_cached_ = 1024)
+        : stack_size((stack_size_ + page_size() - 1) / page_size() * page_size()), max_cached(max_cached_) {}
+
+    fiber_stack_pool(const fiber_stack_pool &) = delete;
+
+    fiber_stack_pool &operator=(const fiber_stack_pool &) = delete;
+
+    ~fiber_stack_pool() {
+        for (const auto &stack: free_stacks) {
+            unmap(stack);
+        }
+    }
+
+    // Shared by spawn_fiber calls that do not name a pool.
+    static fiber_stack_pool &global() {
+        static fiber_stack_pool pool;
+        return pool;
+    }
+
+    // Throws std::bad_alloc when no stack can be mapped.
+    fiber_stack acquire() {
+        {
+            std::lock_guard lock(mutex);
+            if (!free_stacks.empty()) {
+                fiber_stack stack = free_stacks.back();
+                free_stacks.pop_back();
+                return stack;
+            }
+        }
+        fiber_stack stack;
+        stack.mapping_size = stack_size + page_size();
+        stack.mapping = mmap(nullptr, stack.mapping_size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE, -1, 0);
+        if (stack.mapping == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        if (mprotect(stack.mapping, page_size(), PROT_NONE) != 0) {
+            munmap(stack.mapping, stack.mapping_size);
+            throw std::bad_alloc();
+        }
+        stack.bottom = static_cast<char *>(stack.mapping) + page_size();
+        stack.size = stack_size;
+        return stack;
+    }
+
+    void release(const fiber_stack &stack) {
+#ifdef FIBER_ASAN
+        // Frames of the last fiber leave poisoned redzones behind.
+        ASAN_UNPOISON_MEMORY_REGION(stack.bottom, stack.size);
+#endif
+        {
+            std::lock_guard lock(mutex);
+            if (free_stacks.size() < max_cached) {
+                free_stacks.push_back(stack);
+                return;
+            }
+        }
+        unmap(stack);
+    }
+
+    size_t cached() {
+        std::lock_guard lock(mutex);
+        return free_stacks.size();
+    }
+
+    size_t get_stack_size() const { return stack_size; }
+};
+
+// A stackful task run by thread_pool workers (see spawn_fiber). Blocking on a
+// fiber-aware primitive (fiber_wait_queue and what is built on it) switches
+// the worker back to the pool instead of blocking it; the fiber continues,
+// possibly on another worker, once it is woken.
+//
+// Owned by whoever will run it next: the pool task that resumes it, or,
+// while it is suspended, the wait queue it sits in and then the
+// fiber_wake_list it is notified into. It frees itself and its
+// stack when its function returns. The stack is taken when the fiber first
+// runs, so fibers still queued hold none.
+class fiber {
+private:
+    friend class fiber_wake_list;
+
+    thread_pool &pool;
+    fiber_stack_pool &stacks;
+    fiber_stack stack;
+    fiber_context context;
+    // The worker's context while the fiber runs; a new one on every resume.
+    fiber_context *caller = nullptr;
+    bool finished = false;
+    // What the worker does once the fiber is off its stack: unlock the mutex
+    // guarding the wait queue the fiber just joined, or queue it again.
+    std::mutex *unlock_after_switch = nullptr;
+    bool reschedule_after_switch = false;
+    // Link in the fiber_wake_list it was notified into.
+    fiber *next_woken = nullptr;
+#ifdef FIBER_ASAN
+    void *fake_stack = nullptr;
+    const void *caller_bottom = nullptr;
+    size_t caller_size = 0;
+#endif
+
+    // Runs the pending fiber when invoked; frees it if the task is dropped
+    // (shutdown(cancel)). The fiber's frames are then abandoned without
+    // unwinding, and its future fails with task_cancelled.
+    class resume_task {
+    private:
+        fiber *f;
+
+    public:
+        explicit resume_task(fiber *f_) : f(f_) {}
+
+        resume_task(resume_task &&other) noexcept : f(std::exchange(other.f, nullptr)) {}
+
+        resume_task &operator=(resume_task &&) = delete;
+
+        ~resume_task() { delete f; }
+
+        void operator()() { std::exchange(f, nullptr)->run(); }
+    };
+
+    // noinline: a fiber can move between threads, so the compiler must not
+    // keep the address of one thread's slot across a switch.
+    __attribute__((noinline)) static fiber *&current_slot() {
+        static thread_local fiber *slot = nullptr;
+        return slot;
+    }
+
+    static void trampoline(void *arg) {
+        auto *self = static_cast<fiber *>(arg);
+        self->finish_switch_in();
+        self->body();
+        self->finished = true;
+        self->switch_out();
+    }
+
+    void finish_switch_in() {
+#ifdef FIBER_ASAN
+        __sanitizer_finish_switch_fiber(fake_stack, &caller_bottom, &caller_size);
+#endif
+    }
+
+    // On the fiber: back to the worker that resumed it.
+    void switch_out() {
+#ifdef FIBER_ASAN
+        __sanitizer_start_switch_fiber(finished ? nullptr : &fake_stack, caller_bottom, caller_size);
+#endif
+        fiber_context_switch(context, *caller);
+        finish_switch_in();
+    }
+
+    // On a worker: run the fiber until it finishes or suspends.
+    void run() {
+        if (!stack.mapping) {
+            try {
+                stack = stacks.acquire();
+            } catch (...) {
+                fail(std::current_exception());
+                delete this;
+                return;
+            }
+            fiber_context_make(context, stack.bottom, stack.size, &fiber::trampoline, this);
+        }
+        fiber_context worker_context;
+        caller = &worker_context;
+        fiber *const previous = std::exchange(current_slot(), this);
+#ifdef FIBER_ASAN
+        void *worker_fake_stack = nullptr;
+        __sanitizer_start_switch_fiber(&worker_fake_stack, stack.bottom, stack.size);
+#endif
+        fiber_context_switch(worker_context, context);
+#ifdef FIBER_ASAN
+        __sanitizer_finish_switch_fiber(worker_fake_stack, nullptr, nullptr);
+#endif
+        current_slot() = previous;
+        if (finished) {
+            delete this;
+            return;
+        }
+        // Past the unlock or the reschedule another worker may resume the
+        // fiber, so nothing of it is touched afterwards.
+        std::mutex *const m = std::exchange(unlock_after_switch, nullptr);
+        const bool reschedule = std::exchange(reschedule_after_switch, false);
+        if (m) {
+            m->unlock();
+        } else if (reschedule) {
+            resume(task_priority::low);
+        }
+    }
+
+protected:
+    // Runs on the fiber's stack and must not throw.
+    virtual void body() = 0;
+
+    // The fiber could not get a stack and will not run.
+    virtual void fail(std::exception_ptr error) = 0;
+
+public:
+    fiber(thread_pool &pool_, fiber_stack_pool &stacks_) : pool(pool_), stacks(stacks_) {}
+
+    fiber(const fiber &) = delete;
+
+    fiber &operator=(const fiber &) = delete;
+
+    virtual ~fiber() {
+        if (stack.mapping) {
+            stacks.release(stack);
+        }
+    }
+
+    // The fiber running on this thread, or nullptr on a plain thread.
+    static fiber *current() { return current_slot(); }
+
+    // Queue a new fiber on its pool, as an ordinary submission: a bounded
+    // pool's overflow policy applies, and a fiber it drops fails its future.
+    void start() { pool.execute(resume_task(this)); }
+
+    // Queue the fiber on its pool again. Call once per suspension, from
+    // anywhere. Past a bounded pool's limit, since a suspended fiber's resume
+    // must not be dropped or run on the waker.
+    void resume(task_priority priority = task_priority::normal) {
+        pool.post_internal(function_wapper(resume_task(this)), priority);
+    }
+
+    // On the fiber itself: switch back to the worker, which unlocks m once
+    // the fiber is off its stack, so a waker holding m cannot resume the
+    // fiber before it has stopped. Returns, with m unlocked, after resume().
+    void suspend(std::mutex &m) {
+        unlock_after_switch = &m;
+        switch_out();
+    }
+
+    // On the fiber itself: let other queued work run, then continue.
+    void yield() {
+        reschedule_after_switch = true;
+        switch_out();
+    }
+
+    thread_pool &get_pool() const { return pool; }
+};
+
+// The fiber spawn_fiber creates: f's result or exception goes to a future.
+template<typename R, typename F>
+class fiber_task final : public fiber {
+private:
+    task_promise<R> promise;
+    F func;
+
+protected:
+    void body() override { promise.set_from(func); }
+
+    void fail(std::exception_ptr error) override { promise.set_exception(std::move(error)); }
+
+public:
+    fiber_task(thread_pool &pool_, fiber_stack_pool &stacks_, task_promise<R> promise_, F func_)
+        : fiber(pool_, stacks_), promise(std::move(promise_)), func(std::move(func_)) {}
+};
+
+// Yield the current fiber, or the thread when not on a fiber.
+inline void fiber_yield() {
+    if (fiber *f = fiber::current()) {
+        f->yield();
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+// Run f on a new fiber of `pool`, with a stack from `stacks`. Its result or
+// exception arrives through the returned future. Inside f, waits on the
+// fiber-aware primitives (fiber_semaphore, fiber_rwlock, fiber_queue) suspend
+// the fiber rather than the worker, so thousands of blocked fibers can share
+// a few threads. Other blocking calls still block the worker.
+//
+// A fiber must not suspend while it holds a std::mutex or inside a catch
+// block, since it may resume on another thread.
+template<typename F>
+auto spawn_fiber(thread_pool &pool, fiber_stack_pool &stacks, F &&f)
+    -> task_future<std::invoke_result_t<std::decay_t<F> &>> {
+    using result_type = std::invoke_result_t<std::decay_t<F> &>;
+    task_promise<result_type> promise;
+    task_future<result_type> res(promise.get_future());
+    (new fiber_task<result_type, std::decay_t<F>>(pool, stacks, std::move(promise), std::forward<F>(f)))->start();
+    return res;
+}
+
+template<typename F>
+auto spawn_fiber(thread_pool &pool, F &&f) {
+    return spawn_fiber(pool, fiber_stack_pool::global(), std::forward<F>(f));
+}
+
+// Fibers notified under a wait queue's mutex, resumed once it is unlocked, so
+// the resume never runs with the mutex held. Declare it before the lock:
+//     fiber_wake_list woken;
+//     std::lock_guard lock(m);
+//     ...
+//     waiters.notify_one(woken);
+class fiber_wake_list {
+private:
+    fiber *head = nullptr;
+    fiber *tail = nullptr;
+
+public:
+    fiber_wake_list() = default;
+
+    fiber_wake_list(const fiber_wake_list &) = delete;
+
+    fiber_wake_list &operator=(const fiber_wake_list &) = delete;
+
+    void add(fiber *f) {
+        if (tail) {
+            tail->next_woken = f;
+        } else {
+            head = f;
+        }
+        tail = f;
+    }
+
+    // In notification order. Each link is read before its fiber is resumed,
+    // which may run it on another worker at once.
+    ~fiber_wake_list() {
+        while (fiber *f = head) {
+            head = std::exchange(f->next_woken, nullptr);
+            f->resume();
+        }
+    }
+};
+
+// Waiters for a condition guarded by a std::mutex, like a condition_variable,
+// except that a fiber waiting here suspends instead of blocking its worker.
+// Plain threads may wait too; they block as usual. FIFO, no spurious wakeups.
+class fiber_wait_queue {
+private:
+    struct waiter {
+        fiber *f = nullptr;
+        std::condition_variable *cv = nullptr;
+        bool notified = false;
+        waiter *next = nullptr;
+    };
+
+    waiter *head = nullptr;
+    waiter *tail = nullptr;
+
+    void push(waiter *w) {
+        if (tail) {
+            tail->next = w;
+        } else {
+            head = w;
+        }
+        tail = w;
+    }
+
+    // A thread is notified right away; a fiber joins woken.
+    static void wake(waiter *w, fiber_wake_list &woken) {
+        w->notified = true;
+        if (w->f) {
+            woken.add(w->f);
+        } else {
+            w->cv->notify_one();
+        }
+    }
+
+public:
+    fiber_wait_queue() = default;
+
+    fiber_wait_queue(const fiber_wait_queue &) = delete;
+
+    fiber_wait_queue &operator=(const fiber_wait_queue &) = delete;
+
+    // lock is held on entry and on return.
+    void wait(std::unique_lock<std::mutex> &lock) {
+        waiter w;
+        w.f = fiber::current();
+        if (w.f) {
+            push(&w);
+            std::mutex *m = lock.release();
+            w.f->suspend(*m);
+            lock = std::unique_lock(*m);
+        } else {
+            std::condition_variable cv;
+            w.cv = &cv;
+            push(&w);
+            cv.wait(lock, [&] { return w.notified; });
+        }
+    }
+
+    template<typename Predicate>
+    void wait(std::unique_lock<std::mutex> &lock, Predicate ready) {
+        while (!ready()) {
+            wait(lock);
+        }
+    }
+
+    // With the mutex held; a woken fiber resumes when woken goes out of
+    // scope. Returns false when nobody was waiting.
+    bool notify_one(fiber_wake_list &woken) {
+        waiter *w = head;
+        if (!w) {
+            return false;
+        }
+        head = w->next;
+        if (!head) {
+            tail = nullptr;
+        }
+        wake(w, woken);
+        return true;
+    }
+
+    // With the mutex held.
+    void notify_all(fiber_wake_list &woken) {
+        while (notify_one(woken)) {
+        }
+    }
+
+    bool empty() const { return head == nullptr; }
+};
+
+#endif //CPP_CONCURRENCY_FIBER_H
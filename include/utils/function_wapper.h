@@ -0,0 +1,116 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_FUNCTION_WAPPER_H
+#define CPP_CONCURRENCY_FUNCTION_WAPPER_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only type-erased void() callable. Callables up to inline_size bytes are
+// stored in place, larger ones on the heap, so the wrapper itself is one cache line.
+class function_wapper {
+public:
+    static constexpr size_t inline_size = 64 - sizeof(void *);
+
+private:
+    struct operations {
+        void (*call)(void *storage);
+        // Move-construct into dst from src, then destroy src.
+        void (*relocate)(void *dst, void *src) noexcept;
+        void (*destroy)(void *storage) noexcept;
+    };
+
+    template<typename F>
+    static constexpr bool stored_inline = sizeof(F) <= inline_size && alignof(F) <= alignof(std::max_align_t) &&
+                                          std::is_nothrow_move_constructible_v<F>;
+
+    template<typename F>
+    struct inline_operations {
+        static void call(void *storage) { (*static_cast<F *>(storage))(); }
+
+        static void relocate(void *dst, void *src) noexcept {
+            new(dst) F(std::move(*static_cast<F *>(src)));
+            static_cast<F *>(src)->~F();
+        }
+
+        static void destroy(void *storage) noexcept { static_cast<F *>(storage)->~F(); }
+
+        static constexpr operations table{&call, &relocate, &destroy};
+    };
+
+    template<typename F>
+    struct heap_operations {
+        static F *&get(void *storage) { return *static_cast<F **>(storage); }
+
+        static void call(void *storage) { (*get(storage))(); }
+
+        static void relocate(void *dst, void *src) noexcept { new(dst) F *(get(src)); }
+
+        static void destroy(void *storage) noexcept { delete get(storage); }
+
+        static constexpr operations table{&call, &relocate, &destroy};
+    };
+
+    alignas(std::max_align_t) unsigned char storage[inline_size];
+    const operations *ops;
+
+    void reset() noexcept {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+public:
+    template<class F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, function_wapper>>>
+    explicit function_wapper(F &&f) {
+        using functor_type = std::decay_t<F>;
+        if constexpr (stored_inline<functor_type>) {
+            new(storage) functor_type(std::forward<F>(f));
+            ops = &inline_operations<functor_type>::table;
+        } else {
+            new(storage) functor_type *(new functor_type(std::forward<F>(f)));
+            ops = &heap_operations<functor_type>::table;
+        }
+    }
+
+    void operator()() { ops->call(storage); }
+
+    explicit operator bool() const noexcept { return ops != nullptr; }
+
+    function_wapper() noexcept : ops(nullptr) {}
+
+    function_wapper(function_wapper &&other) noexcept : ops(other.ops) {
+        if (ops) {
+            ops->relocate(storage, other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    function_wapper &operator=(function_wapper &&other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops) {
+                other.ops->relocate(storage, other.storage);
+                ops = other.ops;
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    ~function_wapper() { reset(); }
+
+    function_wapper(const function_wapper &other) = delete;
+
+    function_wapper(function_wapper &other) = delete;
+
+    function_wapper &operator=(const function_wapper &other) = delete;
+};
+
+#endif //CPP_CONCURRENCY_FUNCTION_WAPPER_H
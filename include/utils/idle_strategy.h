@@ -0,0 +1,154 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_IDLE_STRATEGY_H
+#define CPP_CONCURRENCY_IDLE_STRATEGY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Tell the core we are in a spin-wait loop (lets the sibling hyper-thread run
+// and avoids the memory-order mis-speculation penalty when the loop exits).
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Block while *addr == expected. May return spuriously.
+inline void futex_wait(std::atomic<uint32_t> &addr, uint32_t expected) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&addr), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    while (addr.load(std::memory_order_acquire) == expected) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+#endif
+}
+
+// Like futex_wait, but gives up after timeout.
+inline void futex_wait_for(std::atomic<uint32_t> &addr, uint32_t expected, std::chrono::nanoseconds timeout) {
+#if defined(__linux__)
+    timespec ts{};
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&addr), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+#else
+    if (addr.load(std::memory_order_acquire) == expected) {
+        std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(timeout, std::chrono::microseconds(50)));
+    }
+#endif
+}
+
+inline void futex_wake(std::atomic<uint32_t> &addr, int count) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&addr), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+    (void) addr;
+    (void) count;
+#endif
+}
+
+// Lets idle threads sleep on "something changed" without losing a wake-up:
+//   key = prepare_wait(); if (!recheck()) commit_wait(key); else cancel_wait();
+// Notifiers only touch the futex when a waiter has announced itself.
+class event_count {
+private:
+    std::atomic<uint32_t> epoch;
+    std::atomic<int> waiters;
+
+public:
+    event_count() : epoch(0), waiters(0) {}
+
+    event_count(const event_count &) = delete;
+
+    event_count &operator=(const event_count &) = delete;
+
+    uint32_t prepare_wait() {
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        return epoch.load(std::memory_order_seq_cst);
+    }
+
+    void cancel_wait() {
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void commit_wait(uint32_t key) {
+        while (epoch.load(std::memory_order_acquire) == key) {
+            futex_wait(epoch, key);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Returns false if the timeout passed without a notification.
+    bool commit_wait_for(uint32_t key, std::chrono::nanoseconds timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (epoch.load(std::memory_order_acquire) == key) {
+            const auto remaining = deadline - std::chrono::steady_clock::now();
+            if (remaining <= std::chrono::nanoseconds::zero()) {
+                break;
+            }
+            futex_wait_for(epoch, key, remaining);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return epoch.load(std::memory_order_acquire) != key;
+    }
+
+    void notify_one() {
+        // Pairs with the seq_cst increment in prepare_wait: either the waiter
+        // sees the state we published, or we see it waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        epoch.fetch_add(1, std::memory_order_release);
+        futex_wake(epoch, 1);
+    }
+
+    void notify_all() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        epoch.fetch_add(1, std::memory_order_release);
+        futex_wake(epoch, INT_MAX);
+    }
+
+    int waiting() const { return waiters.load(std::memory_order_relaxed); }
+};
+
+// What a worker does when it finds no task: spin_count rounds of cpu_relax,
+// then yield_count rounds of yield, then (if park) sleep on an event_count.
+struct idle_policy {
+    unsigned spin_count = 256;
+    unsigned yield_count = 8;
+    bool park = true;
+
+    static idle_policy busy_yield() { return {0, UINT_MAX, false}; }
+
+    static idle_policy low_latency() { return {4096, 64, true}; }
+
+    static idle_policy low_power() { return {16, 0, true}; }
+};
+
+#endif //CPP_CONCURRENCY_IDLE_STRATEGY_H
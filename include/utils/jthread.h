@@ -5,6 +5,8 @@
 #ifndef CPP_CONCURRENCY_JTHREAD_H
 #define CPP_CONCURRENCY_JTHREAD_H
 
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <thread>
 
@@ -49,4 +51,38 @@ public:
     }
 };
 
+// Cooperative cancellation along the lines of C++20 std::stop_source and
+// std::stop_token. Polling a token is a single load, cheap enough for inner
+// loops; a default-constructed token never reports a stop.
+class stop_token {
+private:
+    std::shared_ptr<std::atomic<bool>> state;
+
+    friend class stop_source;
+
+    explicit stop_token(std::shared_ptr<std::atomic<bool>> state_) : state(std::move(state_)) {}
+
+public:
+    stop_token() = default;
+
+    bool stop_requested() const noexcept { return state && state->load(std::memory_order_acquire); }
+
+    bool stop_possible() const noexcept { return static_cast<bool>(state); }
+};
+
+class stop_source {
+private:
+    std::shared_ptr<std::atomic<bool>> state;
+
+public:
+    stop_source() : state(std::make_shared<std::atomic<bool>>(false)) {}
+
+    stop_token get_token() const { return stop_token(state); }
+
+    // True only for the call that actually made the request.
+    bool request_stop() noexcept { return !state->exchange(true, std::memory_order_acq_rel); }
+
+    bool stop_requested() const noexcept { return state->load(std::memory_order_acquire); }
+};
+
 #endif //CPP_CONCURRENCY_JTHREAD_H
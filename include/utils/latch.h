@@ -0,0 +1,107 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_LATCH_H
+#define CPP_CONCURRENCY_LATCH_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+#include "idle_strategy.h"
+
+// Single-use counter that releases waiters when it reaches zero. The first
+// exception handed to set_exception is rethrown from wait().
+class countdown_latch {
+private:
+    static constexpr unsigned spin_count = 1024;
+
+    std::atomic<std::ptrdiff_t> count;
+    // 0 = open, 1 = open with sleepers, 2 = released; doubles as the futex word.
+    std::atomic<uint32_t> status;
+    // 0 = no error, 1 = error being stored, 2 = error readable.
+    std::atomic<uint32_t> error_state;
+    std::exception_ptr error;
+
+public:
+    explicit countdown_latch(std::ptrdiff_t expected) : count(expected), status(expected > 0 ? 0 : 2),
+                                                         error_state(0) {}
+
+    countdown_latch(const countdown_latch &) = delete;
+
+    countdown_latch &operator=(const countdown_latch &) = delete;
+
+    void count_down(std::ptrdiff_t n = 1) {
+        if (count.fetch_sub(n, std::memory_order_acq_rel) == n) {
+            if (status.exchange(2, std::memory_order_release) == 1) {
+                futex_wake(status, INT_MAX);
+            }
+        }
+    }
+
+    bool is_ready() const { return status.load(std::memory_order_acquire) == 2; }
+
+    // Keeps the first error only; later ones are dropped. The error is
+    // published only once it is stored, so a waiter released by another
+    // thread's count_down never reads it half-written.
+    void set_exception(std::exception_ptr e) {
+        uint32_t expected = 0;
+        if (error_state.compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+            error = std::move(e);
+            error_state.store(2, std::memory_order_release);
+        }
+    }
+
+    // True as soon as an error is claimed, so running work can stop early.
+    bool failed() const { return error_state.load(std::memory_order_acquire) != 0; }
+
+    // Release waiters now with e (unless an earlier error is already set),
+    // whatever the count.
+    void abort(std::exception_ptr e) {
+        set_exception(std::move(e));
+        if (status.exchange(2, std::memory_order_release) == 1) {
+            futex_wake(status, INT_MAX);
+        }
+    }
+
+    // Unlike wait(), returns instead of rethrowing: true if the latch opened.
+    bool wait_for(std::chrono::nanoseconds timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!is_ready()) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                return false;
+            }
+            uint32_t expected = 0;
+            if (status.compare_exchange_strong(expected, 1, std::memory_order_acq_rel) || expected == 1) {
+                futex_wait_for(status, 1, deadline - now);
+            }
+        }
+        return true;
+    }
+
+    void wait() {
+        for (unsigned i = 0; i < spin_count && !is_ready(); ++i) {
+            cpu_relax();
+        }
+        while (!is_ready()) {
+            uint32_t expected = 0;
+            if (status.compare_exchange_strong(expected, 1, std::memory_order_acq_rel) || expected == 1) {
+                futex_wait(status, 1);
+            }
+        }
+        if (failed()) {
+            // The setter may still be storing the error it claimed.
+            while (error_state.load(std::memory_order_acquire) != 2) {
+                cpu_relax();
+            }
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+#endif //CPP_CONCURRENCY_LATCH_H
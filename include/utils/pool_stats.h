@@ -0,0 +1,183 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_POOL_STATS_H
+#define CPP_CONCURRENCY_POOL_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Define to 1 before including thread_pool.h to build the per-worker counters
+// in. At 0 (the default) the pool carries no counters and records nothing;
+// thread_pool::stats() then returns an empty snapshot.
+#ifndef THREAD_POOL_ENABLE_STATS
+#define THREAD_POOL_ENABLE_STATS 0
+#endif
+
+// Bucket i counts durations in [2^i, 2^(i+1)) ns; bucket 0 also takes 0 and 1.
+struct latency_histogram {
+    static constexpr size_t bucket_count = 40;
+
+    std::array<uint64_t, bucket_count> buckets{};
+
+    static size_t bucket_of(int64_t ns) {
+        if (ns <= 1) {
+            return 0;
+        }
+        const size_t bucket = 63 - __builtin_clzll(static_cast<uint64_t>(ns));
+        return bucket < bucket_count ? bucket : bucket_count - 1;
+    }
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (uint64_t n: buckets) {
+            total += n;
+        }
+        return total;
+    }
+
+    void merge(const latency_histogram &other) {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            buckets[i] += other.buckets[i];
+        }
+    }
+
+    // Upper bound of the bucket holding the p-th fraction (0..1) of samples.
+    std::chrono::nanoseconds percentile(double p) const {
+        const uint64_t total = count();
+        if (total == 0) {
+            return std::chrono::nanoseconds(0);
+        }
+        const auto rank = static_cast<uint64_t>(p * static_cast<double>(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return std::chrono::nanoseconds(int64_t(2) << i);
+            }
+        }
+        return std::chrono::nanoseconds(int64_t(2) << (bucket_count - 1));
+    }
+};
+
+struct worker_stats {
+    uint64_t tasks_executed = 0;
+    std::chrono::nanoseconds busy{0};
+    std::chrono::nanoseconds idle{0};
+    uint64_t steal_attempts = 0;
+    uint64_t steal_successes = 0;
+    // Own deque plus own-node lanes, sampled every depth_sample_period tasks.
+    uint64_t depth_samples = 0;
+    uint64_t depth_total = 0;
+    uint64_t depth_max = 0;
+    // Submit to start, and start to end.
+    latency_histogram queue_latency;
+    latency_histogram run_latency;
+
+    void merge(const worker_stats &other) {
+        tasks_executed += other.tasks_executed;
+        busy += other.busy;
+        idle += other.idle;
+        steal_attempts += other.steal_attempts;
+        steal_successes += other.steal_successes;
+        depth_samples += other.depth_samples;
+        depth_total += other.depth_total;
+        depth_max = depth_max > other.depth_max ? depth_max : other.depth_max;
+        queue_latency.merge(other.queue_latency);
+        run_latency.merge(other.run_latency);
+    }
+};
+
+struct pool_stats {
+    bool enabled = false;
+    std::vector<worker_stats> workers;
+
+    worker_stats total() const {
+        worker_stats result;
+        for (const auto &w: workers) {
+            result.merge(w);
+        }
+        return result;
+    }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const worker_stats &w) {
+    const double busy_ms = std::chrono::duration<double, std::milli>(w.busy).count();
+    const double idle_ms = std::chrono::duration<double, std::milli>(w.idle).count();
+    os << "tasks=" << w.tasks_executed << " busy=" << busy_ms << "ms idle=" << idle_ms << "ms"
+       << " steals=" << w.steal_successes << "/" << w.steal_attempts
+       << " depth_avg=" << (w.depth_samples ? double(w.depth_total) / double(w.depth_samples) : 0.0)
+       << " depth_max=" << w.depth_max
+       << " queue_p50=" << w.queue_latency.percentile(0.5).count() << "ns"
+       << " queue_p99=" << w.queue_latency.percentile(0.99).count() << "ns"
+       << " run_p50=" << w.run_latency.percentile(0.5).count() << "ns"
+       << " run_p99=" << w.run_latency.percentile(0.99).count() << "ns";
+    return os;
+}
+
+inline std::ostream &operator<<(std::ostream &os, const pool_stats &stats) {
+    if (!stats.enabled) {
+        return os << "thread_pool stats disabled (THREAD_POOL_ENABLE_STATS=0)\n";
+    }
+    for (size_t i = 0; i < stats.workers.size(); ++i) {
+        os << "worker " << i << ": " << stats.workers[i] << '\n';
+    }
+    return os << "total: " << stats.total() << '\n';
+}
+
+#if THREAD_POOL_ENABLE_STATS
+// One worker's counters, on their own cache lines. Only the owning worker
+// writes them, so updates are a relaxed load and store instead of an RMW;
+// readers may see a snapshot that is a few updates behind.
+struct alignas(64) worker_counters {
+    static constexpr unsigned depth_sample_period = 64;
+
+    std::atomic<uint64_t> tasks_executed{0};
+    std::atomic<uint64_t> busy_ns{0};
+    std::atomic<uint64_t> idle_ns{0};
+    std::atomic<uint64_t> steal_attempts{0};
+    std::atomic<uint64_t> steal_successes{0};
+    std::atomic<uint64_t> depth_samples{0};
+    std::atomic<uint64_t> depth_total{0};
+    std::atomic<uint64_t> depth_max{0};
+    std::array<std::atomic<uint64_t>, latency_histogram::bucket_count> queue_latency{};
+    std::array<std::atomic<uint64_t>, latency_histogram::bucket_count> run_latency{};
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void sample_depth(uint64_t depth) {
+        add(depth_samples);
+        add(depth_total, depth);
+        if (depth > depth_max.load(std::memory_order_relaxed)) {
+            depth_max.store(depth, std::memory_order_relaxed);
+        }
+    }
+
+    worker_stats snapshot() const {
+        worker_stats w;
+        w.tasks_executed = tasks_executed.load(std::memory_order_relaxed);
+        w.busy = std::chrono::nanoseconds(busy_ns.load(std::memory_order_relaxed));
+        w.idle = std::chrono::nanoseconds(idle_ns.load(std::memory_order_relaxed));
+        w.steal_attempts = steal_attempts.load(std::memory_order_relaxed);
+        w.steal_successes = steal_successes.load(std::memory_order_relaxed);
+        w.depth_samples = depth_samples.load(std::memory_order_relaxed);
+        w.depth_total = depth_total.load(std::memory_order_relaxed);
+        w.depth_max = depth_max.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < latency_histogram::bucket_count; ++i) {
+            w.queue_latency.buckets[i] = queue_latency[i].load(std::memory_order_relaxed);
+            w.run_latency.buckets[i] = run_latency[i].load(std::memory_order_relaxed);
+        }
+        return w;
+    }
+};
+#endif
+
+#endif //CPP_CONCURRENCY_POOL_STATS_H
@@ -0,0 +1,158 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_POOL_TRACE_H
+#define CPP_CONCURRENCY_POOL_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Define to 1 before including thread_pool.h to record when every task
+// starts and ends on which worker. At 0 (the default) nothing is recorded and
+// thread_pool::write_trace writes an empty trace.
+#ifndef THREAD_POOL_ENABLE_TRACING
+#define THREAD_POOL_ENABLE_TRACING 0
+#endif
+
+// Raw timestamps: the TSC on x86, steady_clock nanoseconds elsewhere.
+struct trace_clock {
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+};
+
+// Maps trace_clock ticks to time since the calibration was taken; the rate is
+// measured against steady_clock over the whole interval, so it firms up as
+// the pool runs.
+class trace_calibration {
+private:
+    uint64_t origin_ticks;
+    std::chrono::steady_clock::time_point origin_time;
+
+public:
+    trace_calibration() : origin_ticks(trace_clock::now()), origin_time(std::chrono::steady_clock::now()) {}
+
+    uint64_t origin() const { return origin_ticks; }
+
+    double ns_per_tick() const {
+        const uint64_t ticks = trace_clock::now() - origin_ticks;
+        const auto elapsed = std::chrono::steady_clock::now() - origin_time;
+        if (ticks == 0) {
+            return 1.0;
+        }
+        return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(ticks);
+    }
+};
+
+// One task run, in trace_clock ticks.
+struct trace_event {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+};
+
+// Chrome trace_event JSON (loads in Perfetto and chrome://tracing): one
+// thread per worker, one complete ("X") event per task. Tasks a worker ran
+// while waiting inside another task show up nested under it.
+inline void write_chrome_trace(std::ostream &os, const std::vector<std::vector<trace_event>> &workers,
+                               uint64_t origin, double ns_per_tick) {
+    const auto flags = os.flags();
+    os << std::fixed;
+    os.precision(3);
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&] {
+        if (!first) {
+            os << ",\n";
+        }
+        first = false;
+    };
+    for (size_t worker = 0; worker < workers.size(); ++worker) {
+        separator();
+        os << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << worker
+           << R"(,"args":{"name":"worker )" << worker << "\"}}";
+        for (const trace_event &e: workers[worker]) {
+            const double ts = static_cast<double>(e.begin - origin) * ns_per_tick / 1000.0;
+            const double dur = static_cast<double>(e.end - e.begin) * ns_per_tick / 1000.0;
+            separator();
+            os << R"({"name":"task","cat":"thread_pool","ph":"X","pid":1,"tid":)" << worker
+               << ",\"ts\":" << ts << ",\"dur\":" << dur << '}';
+        }
+    }
+    os << "]}\n";
+    os.flags(flags);
+}
+
+#if THREAD_POOL_ENABLE_TRACING
+// One worker's most recent events. Only the owning worker writes; it never
+// waits and overwrites the oldest event when full. Readers copy while it runs
+// and drop whatever may have been overwritten during the copy.
+class alignas(64) trace_ring {
+private:
+    const size_t mask;
+    // begin, end of each slot; relaxed atomics so concurrent reads are defined.
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    std::atomic<uint64_t> head{0};
+
+    static size_t round_up(size_t n) {
+        size_t capacity = 2;
+        while (capacity < n) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+public:
+    explicit trace_ring(size_t capacity = 1 << 16)
+        : mask(round_up(capacity) - 1), slots(std::make_unique<std::atomic<uint64_t>[]>(2 * (mask + 1))) {}
+
+    size_t capacity() const { return mask + 1; }
+
+    void record(uint64_t begin, uint64_t end) {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        std::atomic<uint64_t> *slot = &slots[2 * (h & mask)];
+        slot[0].store(begin, std::memory_order_relaxed);
+        slot[1].store(end, std::memory_order_relaxed);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Events ever recorded, including overwritten ones.
+    uint64_t recorded() const { return head.load(std::memory_order_acquire); }
+
+    std::vector<trace_event> snapshot() const {
+        const uint64_t h = head.load(std::memory_order_acquire);
+        const uint64_t first = h > capacity() ? h - capacity() : 0;
+        std::vector<trace_event> events;
+        events.reserve(h - first);
+        for (uint64_t i = first; i < h; ++i) {
+            const std::atomic<uint64_t> *slot = &slots[2 * (i & mask)];
+            events.push_back(trace_event{slot[0].load(std::memory_order_relaxed),
+                                         slot[1].load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // The writer fills slot h before publishing it, so slot h - capacity
+        // may already be torn.
+        const uint64_t now = head.load(std::memory_order_relaxed);
+        const uint64_t valid = now >= capacity() ? now - capacity() + 1 : 0;
+        if (valid > first) {
+            events.erase(events.begin(), events.begin() + static_cast<std::ptrdiff_t>(std::min(valid, h) - first));
+        }
+        return events;
+    }
+};
+#endif
+
+#endif //CPP_CONCURRENCY_POOL_TRACE_H
@@ -0,0 +1,128 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_STRAND_H
+#define CPP_CONCURRENCY_STRAND_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "function_wapper.h"
+#include "thread_pool.h"
+#include "data_structure/mpsc_queue.h"
+
+// Serial executor on top of a thread_pool: tasks posted to one strand run one
+// at a time, in the order they were posted, on whichever worker picks the
+// strand up. A strand costs a few words while idle and is put on the pool only
+// when it has work, so thousands of them can share one pool instead of
+// guarding each object with a mutex that blocks workers.
+//
+// Posting is a lock-free push onto the strand's MPSC queue; the first post to
+// an idle strand also schedules it. The scheduled task runs up to max_batch
+// queued tasks back to back, with the object's data still in cache, then
+// requeues the strand at low priority so one busy strand cannot hog a worker;
+// lane aging keeps it from starving in turn.
+//
+// On a bounded pool the strand is queued past the limit, so no overflow
+// policy drops it while it is marked scheduled, and post never blocks or runs
+// the task on the caller. Like thread_pool::execute, tasks must not throw.
+// Tasks posted before the strand is destroyed still run; they keep its queue
+// alive, not the objects they refer to.
+class strand {
+private:
+    static constexpr unsigned max_batch = 64;
+
+    struct node : mpsc_node {
+        function_wapper fn;
+    };
+
+    struct state {
+        intrusive_mpsc_queue tasks;
+        // Set from the post that finds the strand idle until the runner
+        // drains it; whoever flips it to true schedules the strand.
+        std::atomic<bool> scheduled{false};
+
+        ~state() {
+            while (mpsc_node *n = tasks.pop()) {
+                delete static_cast<node *>(n);
+            }
+        }
+    };
+
+    thread_pool &pool;
+    std::shared_ptr<state> queue;
+
+    inline static thread_local const state *running = nullptr;
+
+    static void schedule(thread_pool &pool, std::shared_ptr<state> s,
+                         task_priority priority = task_priority::normal) {
+        pool.post_internal(function_wapper([&pool, s = std::move(s)]() mutable { run(pool, std::move(s)); }),
+                           priority);
+    }
+
+    static void run(thread_pool &pool, std::shared_ptr<state> s) {
+        const state *const outer = running;
+        running = s.get();
+        for (;;) {
+            for (unsigned i = 0; i < max_batch; ++i) {
+                std::unique_ptr<node> n(static_cast<node *>(s->tasks.pop()));
+                if (!n) {
+                    break;
+                }
+                n->fn();
+            }
+            if (!s->tasks.empty()) {
+                // Batch used up: a normal task would land on this worker's
+                // deque and run next, ahead of everything else.
+                running = outer;
+                schedule(pool, std::move(s), task_priority::low);
+                return;
+            }
+            s->scheduled.store(false, std::memory_order_seq_cst);
+            // A post that saw scheduled still true relies on us to pick it up.
+            // Another runner may own the queue from here on, so only the
+            // atomic head can be read until the exchange wins it back.
+            if (s->tasks.drained() || s->scheduled.exchange(true, std::memory_order_acq_rel)) {
+                break;
+            }
+        }
+        running = outer;
+    }
+
+public:
+    explicit strand(thread_pool &pool_) : pool(pool_), queue(std::make_shared<state>()) {}
+
+    strand(const strand &) = delete;
+
+    strand &operator=(const strand &) = delete;
+
+    template<typename F>
+    void post(F &&f) {
+        auto *n = new node;
+        n->fn = function_wapper(std::forward<F>(f));
+        queue->tasks.push(n);
+        if (!queue->scheduled.load(std::memory_order_seq_cst) &&
+            !queue->scheduled.exchange(true, std::memory_order_acq_rel)) {
+            schedule(pool, queue);
+        }
+    }
+
+    // Runs f right here when called from a task of this strand, else posts it.
+    template<typename F>
+    void dispatch(F &&f) {
+        if (running_in_this_thread()) {
+            std::forward<F>(f)();
+        } else {
+            post(std::forward<F>(f));
+        }
+    }
+
+    // True inside a task of this strand.
+    bool running_in_this_thread() const { return running == queue.get(); }
+
+    thread_pool &get_pool() const { return pool; }
+};
+
+#endif //CPP_CONCURRENCY_STRAND_H
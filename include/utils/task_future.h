@@ -0,0 +1,543 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_TASK_FUTURE_H
+#define CPP_CONCURRENCY_TASK_FUTURE_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "function_wapper.h"
+#include "idle_strategy.h"
+
+template<typename T>
+class task_state_pool;
+
+// What a future holds when its task was dropped without running because the
+// pool shut down (see thread_pool::shutdown).
+class task_cancelled : public std::runtime_error {
+public:
+    task_cancelled() : std::runtime_error("task cancelled") {}
+
+protected:
+    explicit task_cancelled(const char *what) : std::runtime_error(what) {}
+};
+
+// A task dropped because the pool's queue was full (see overflow_policy).
+class task_rejected : public task_cancelled {
+public:
+    task_rejected() : task_cancelled("task rejected: queue full") {}
+};
+
+// While one of these is alive on a thread, promises dropped there without a
+// result complete their futures with task_cancelled (or task_rejected)
+// instead of broken_promise.
+class cancellation_scope {
+private:
+    inline static thread_local unsigned depth = 0;
+    inline static thread_local bool rejecting = false;
+
+    const bool outer_rejecting;
+
+public:
+    explicit cancellation_scope(bool rejected = false) : outer_rejecting(rejecting) {
+        ++depth;
+        rejecting = rejected;
+    }
+
+    ~cancellation_scope() {
+        --depth;
+        rejecting = outer_rejecting;
+    }
+
+    cancellation_scope(const cancellation_scope &) = delete;
+
+    cancellation_scope &operator=(const cancellation_scope &) = delete;
+
+    static bool active() { return depth != 0; }
+
+    // Code that a drop resumes (a coroutine whose resumption was dropped)
+    // runs as if outside every scope.
+    class outside {
+    private:
+        const unsigned saved_depth;
+        const bool saved_rejecting;
+
+    public:
+        outside() : saved_depth(std::exchange(depth, 0)), saved_rejecting(std::exchange(rejecting, false)) {}
+
+        ~outside() {
+            depth = saved_depth;
+            rejecting = saved_rejecting;
+        }
+
+        outside(const outside &) = delete;
+
+        outside &operator=(const outside &) = delete;
+    };
+
+    // The error for a task dropped in the innermost scope.
+    static std::exception_ptr error() {
+        return rejecting ? std::make_exception_ptr(task_rejected()) : std::make_exception_ptr(task_cancelled());
+    }
+};
+
+// Shared state of a task_promise / task_future pair. status is also the futex
+// word: readers spin on it first and only sleep (setting has_waiters) if the
+// result is slow to arrive, so the producer skips the wake syscall in the
+// common case.
+template<typename T>
+class task_state {
+private:
+    friend class task_state_pool<T>;
+
+    using value_type = std::conditional_t<std::is_void_v<T>, char, T>;
+
+    static constexpr uint32_t pending = 0;
+    static constexpr uint32_t has_waiters = 1;
+    static constexpr uint32_t ready = 2;
+    static constexpr unsigned spin_count = 1024;
+
+    // Whichever of publish / set_continuation comes second runs the continuation.
+    static constexpr uint32_t no_continuation = 0;
+    static constexpr uint32_t continuation_set = 1;
+    static constexpr uint32_t continuation_fired = 2;
+
+    std::atomic<uint32_t> status{pending};
+    std::atomic<int> refs{1};
+    std::atomic<uint32_t> continuation_status{no_continuation};
+    std::optional<value_type> value;
+    std::exception_ptr error;
+    function_wapper continuation;
+
+    void publish() {
+        if (status.exchange(ready, std::memory_order_acq_rel) == has_waiters) {
+            futex_wake(status, INT_MAX);
+        }
+        if (continuation_status.exchange(continuation_fired, std::memory_order_acq_rel) == continuation_set) {
+            run_continuation();
+        }
+    }
+
+    void run_continuation() {
+        function_wapper c(std::move(continuation));
+        c();
+    }
+
+    bool spin_until_ready() {
+        for (unsigned i = 0; i < spin_count; ++i) {
+            if (is_ready()) {
+                return true;
+            }
+            cpu_relax();
+        }
+        return is_ready();
+    }
+
+    // Announce a sleeper; false if the result arrived meanwhile.
+    bool mark_has_waiters() {
+        uint32_t expected = pending;
+        return status.compare_exchange_strong(expected, has_waiters, std::memory_order_acq_rel) ||
+               expected == has_waiters;
+    }
+
+public:
+    bool is_ready() const { return status.load(std::memory_order_acquire) == ready; }
+
+    void wait() {
+        if (spin_until_ready()) {
+            return;
+        }
+        while (mark_has_waiters()) {
+            futex_wait(status, has_waiters);
+        }
+    }
+
+    template<typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period> &timeout) {
+        if (is_ready()) {
+            return std::future_status::ready;
+        }
+        if (timeout <= timeout.zero()) {
+            return std::future_status::timeout;
+        }
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        if (spin_until_ready()) {
+            return std::future_status::ready;
+        }
+        while (mark_has_waiters()) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                return std::future_status::timeout;
+            }
+            futex_wait_for(status, has_waiters, deadline - now);
+        }
+        return std::future_status::ready;
+    }
+
+    template<typename... Args>
+    void set_value(Args &&...args) {
+        value.emplace(std::forward<Args>(args)...);
+        publish();
+    }
+
+    void set_exception(std::exception_ptr e) {
+        error = std::move(e);
+        publish();
+    }
+
+    T get() {
+        wait();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*value);
+        }
+    }
+
+    // At most one per state. Runs on the thread that publishes the result, or
+    // right here if it is already published.
+    void set_continuation(function_wapper c) {
+        continuation = std::move(c);
+        if (continuation_status.exchange(continuation_set, std::memory_order_acq_rel) == continuation_fired) {
+            run_continuation();
+        }
+    }
+
+    void add_ref() { refs.fetch_add(1, std::memory_order_relaxed); }
+
+    void release() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            task_state_pool<T>::recycle(this);
+        }
+    }
+};
+
+// Per-thread free list of shared states. States usually die on the thread that
+// created them (the submitter drops the future last), so no synchronisation is
+// needed to reuse them.
+template<typename T>
+class task_state_pool {
+private:
+    static constexpr size_t capacity = 1024;
+
+    struct free_list {
+        std::vector<task_state<T> *> states;
+
+        free_list() { states.reserve(capacity); }
+
+        ~free_list() {
+            for (auto *state: states) {
+                delete state;
+            }
+        }
+    };
+
+    static free_list &local() {
+        static thread_local free_list list;
+        return list;
+    }
+
+public:
+    static task_state<T> *acquire() {
+        auto &list = local().states;
+        if (list.empty()) {
+            return new task_state<T>;
+        }
+        task_state<T> *state = list.back();
+        list.pop_back();
+        return state;
+    }
+
+    static void recycle(task_state<T> *state) {
+        state->value.reset();
+        state->error = nullptr;
+        state->status.store(task_state<T>::pending, std::memory_order_relaxed);
+        state->continuation_status.store(task_state<T>::no_continuation, std::memory_order_relaxed);
+        state->refs.store(1, std::memory_order_relaxed);
+        auto &list = local().states;
+        if (list.size() < capacity) {
+            list.push_back(state);
+        } else {
+            delete state;
+        }
+    }
+};
+
+template<typename T>
+class task_promise;
+
+template<typename T, typename F>
+struct continuation_result {
+    using type = std::invoke_result_t<std::decay_t<F> &, T>;
+};
+
+template<typename F>
+struct continuation_result<void, F> {
+    using type = std::invoke_result_t<std::decay_t<F> &>;
+};
+
+template<typename T>
+class task_future {
+private:
+    static_assert(!std::is_reference_v<T>, "task_future does not hold references");
+
+    template<typename U>
+    friend class task_promise;
+
+    task_state<T> *state;
+
+    explicit task_future(task_state<T> *state_) : state(state_) {}
+
+public:
+    task_future() : state(nullptr) {}
+
+    task_future(task_future &&other) noexcept : state(std::exchange(other.state, nullptr)) {}
+
+    task_future &operator=(task_future &&other) noexcept {
+        if (this != &other) {
+            if (state) {
+                state->release();
+            }
+            state = std::exchange(other.state, nullptr);
+        }
+        return *this;
+    }
+
+    task_future(const task_future &) = delete;
+
+    task_future &operator=(const task_future &) = delete;
+
+    ~task_future() {
+        if (state) {
+            state->release();
+        }
+    }
+
+    bool valid() const { return state != nullptr; }
+
+    // Non-blocking poll.
+    bool is_ready() const { return state->is_ready(); }
+
+    void wait() const { state->wait(); }
+
+    template<typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period> &timeout) const {
+        return state->wait_for(timeout);
+    }
+
+    // Like std::future::get, the future is no longer valid afterwards.
+    T get() {
+        task_future holder(std::move(*this));
+        return holder.state->get();
+    }
+
+    // Run callback (void()) inline on whichever thread completes the result,
+    // or immediately if it is already complete. One callback per future; the
+    // future stays valid for get().
+    template<typename F>
+    void on_ready(F &&callback) {
+        // Only the state is touched from here on: the callback may consume this future.
+        task_state<T> *const s = state;
+        s->set_continuation(function_wapper(std::forward<F>(callback)));
+    }
+
+    // Once the result is ready, schedule fn(value) (fn() for void) on executor
+    // and return a future for its result. Nothing blocks in between; an
+    // exception skips fn and is forwarded. The future is consumed.
+    template<typename Executor, typename F>
+    auto then(Executor &executor, F &&fn) -> task_future<typename continuation_result<T, F>::type> {
+        using result_type = typename continuation_result<T, F>::type;
+        task_promise<result_type> promise;
+        task_future<result_type> result = promise.get_future();
+        task_state<T> *const s = state;
+        s->set_continuation(function_wapper(
+            [&executor, source = std::move(*this), promise = std::move(promise),
+             func = std::forward<F>(fn)]() mutable {
+                executor.execute([source = std::move(source), promise = std::move(promise),
+                                  func = std::move(func)]() mutable {
+                    promise.set_from([&]() -> result_type {
+                        if constexpr (std::is_void_v<T>) {
+                            source.get();
+                            return func();
+                        } else {
+                            return func(source.get());
+                        }
+                    });
+                });
+            }));
+        return result;
+    }
+};
+
+template<typename T>
+class task_promise {
+private:
+    // Just the pointer, so a promise plus a small callable still fits inline in a function_wapper.
+    task_state<T> *state;
+
+public:
+    task_promise() : state(task_state_pool<T>::acquire()) {}
+
+    task_promise(task_promise &&other) noexcept : state(std::exchange(other.state, nullptr)) {}
+
+    task_promise &operator=(task_promise &&) = delete;
+
+    task_promise(const task_promise &) = delete;
+
+    task_promise &operator=(const task_promise &) = delete;
+
+    // A promise dropped without a result (e.g. its task was discarded) still
+    // completes the future, so nobody waits forever.
+    ~task_promise() {
+        if (!state) {
+            return;
+        }
+        if (!state->is_ready()) {
+            if (cancellation_scope::active()) {
+                state->set_exception(cancellation_scope::error());
+            } else {
+                state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+            }
+        }
+        state->release();
+    }
+
+    task_future<T> get_future() {
+        state->add_ref();
+        return task_future<T>(state);
+    }
+
+    template<typename... Args>
+    void set_value(Args &&...args) {
+        state->set_value(std::forward<Args>(args)...);
+    }
+
+    void set_exception(std::exception_ptr e) {
+        state->set_exception(std::move(e));
+    }
+
+    // Run f and store its result or exception.
+    template<typename F>
+    void set_from(F &&f) {
+        try {
+            if constexpr (std::is_void_v<T>) {
+                std::invoke(std::forward<F>(f));
+                set_value();
+            } else {
+                set_value(std::invoke(std::forward<F>(f)));
+            }
+        } catch (...) {
+            set_exception(std::current_exception());
+        }
+    }
+};
+
+template<typename T>
+using when_all_result_t = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+
+// Future for all results, in input order; fails with the first exception found.
+// No thread waits: each input's completion counts down, the last one collects.
+template<typename T>
+task_future<when_all_result_t<T>> when_all(std::vector<task_future<T>> futures) {
+    struct block {
+        std::vector<task_future<T>> inputs;
+        std::atomic<size_t> remaining;
+        task_promise<when_all_result_t<T>> promise;
+
+        explicit block(std::vector<task_future<T>> inputs_) : inputs(std::move(inputs_)), remaining(inputs.size()) {}
+
+        when_all_result_t<T> collect() {
+            if constexpr (std::is_void_v<T>) {
+                for (auto &f: inputs) {
+                    f.get();
+                }
+            } else {
+                std::vector<T> values;
+                values.reserve(inputs.size());
+                for (auto &f: inputs) {
+                    values.push_back(f.get());
+                }
+                return values;
+            }
+        }
+    };
+
+    auto b = std::make_shared<block>(std::move(futures));
+    task_future<when_all_result_t<T>> result = b->promise.get_future();
+    const size_t count = b->inputs.size();
+    if (count == 0) {
+        b->promise.set_from([&] { return b->collect(); });
+        return result;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        b->inputs[i].on_ready([b] {
+            if (b->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                b->promise.set_from([&] { return b->collect(); });
+            }
+        });
+    }
+    return result;
+}
+
+template<typename T>
+struct when_any_result {
+    size_t index;
+    std::vector<task_future<T>> futures;
+};
+
+// Future that completes with the index of the first input to finish (value or
+// exception) and all the input futures.
+template<typename T>
+task_future<when_any_result<T>> when_any(std::vector<task_future<T>> futures) {
+    struct block {
+        std::vector<task_future<T>> inputs;
+        std::atomic<size_t> winner{SIZE_MAX};
+        // Released by the winner and by the registering thread; the second one
+        // hands the inputs over, so they are never moved while still being registered.
+        std::atomic<int> gate{2};
+        task_promise<when_any_result<T>> promise;
+
+        explicit block(std::vector<task_future<T>> inputs_) : inputs(std::move(inputs_)) {}
+
+        void release_gate() {
+            if (gate.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                promise.set_value(when_any_result<T>{winner.load(std::memory_order_acquire), std::move(inputs)});
+            }
+        }
+    };
+
+    auto b = std::make_shared<block>(std::move(futures));
+    task_future<when_any_result<T>> result = b->promise.get_future();
+    const size_t count = b->inputs.size();
+    if (count == 0) {
+        b->promise.set_exception(std::make_exception_ptr(std::invalid_argument("when_any of no futures")));
+        return result;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        b->inputs[i].on_ready([b, i] {
+            size_t expected = SIZE_MAX;
+            if (b->winner.compare_exchange_strong(expected, i, std::memory_order_acq_rel)) {
+                b->release_gate();
+            }
+        });
+    }
+    b->release_gate();
+    return result;
+}
+
+#endif //CPP_CONCURRENCY_TASK_FUTURE_H
@@ -0,0 +1,202 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_TASK_GRAPH_H
+#define CPP_CONCURRENCY_TASK_GRAPH_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+// A DAG of void() tasks run on a thread_pool. Each node keeps an atomic count
+// of unfinished predecessors; whoever finishes the last predecessor schedules
+// the node, so no worker ever waits on another. The structure is built once
+// and can be run any number of times without allocating.
+class task_graph {
+public:
+    using node_id = size_t;
+
+private:
+    struct node {
+        function_wapper fn;
+        std::vector<node_id> successors;
+        unsigned predecessor_count = 0;
+        std::atomic<unsigned> pending{0};
+    };
+
+    std::vector<std::unique_ptr<node>> nodes;
+    bool validated = true;
+    thread_pool *pool = nullptr;
+    std::optional<countdown_latch> finished;
+
+    void validate() {
+        // Kahn's algorithm: every node must be reachable from a root.
+        std::vector<unsigned> in_degree(nodes.size());
+        std::vector<node_id> ready;
+        for (node_id i = 0; i < nodes.size(); ++i) {
+            in_degree[i] = nodes[i]->predecessor_count;
+            if (in_degree[i] == 0) {
+                ready.push_back(i);
+            }
+        }
+        size_t visited = 0;
+        while (!ready.empty()) {
+            node_id id = ready.back();
+            ready.pop_back();
+            ++visited;
+            for (node_id next: nodes[id]->successors) {
+                if (--in_degree[next] == 0) {
+                    ready.push_back(next);
+                }
+            }
+        }
+        if (visited != nodes.size()) {
+            throw std::logic_error("task_graph contains a cycle");
+        }
+        validated = true;
+    }
+
+    // Owned by a queued node task. If the pool drops the task unrun (a full
+    // queue, shutdown(cancel)), the node and everything only it would have
+    // released still count down, with the drop's error, so run() returns
+    // only once no task of this run can touch the graph any more.
+    class node_token {
+    private:
+        task_graph *graph;
+        node_id id;
+
+    public:
+        node_token(task_graph *graph_, node_id id_) : graph(graph_), id(id_) {}
+
+        node_token(node_token &&other) noexcept : graph(std::exchange(other.graph, nullptr)), id(other.id) {}
+
+        node_token &operator=(node_token &&) = delete;
+
+        ~node_token() {
+            if (graph) {
+                graph->finished->set_exception(cancellation_scope::active()
+                                               ? cancellation_scope::error()
+                                               : std::make_exception_ptr(task_cancelled()));
+                graph->skip_from(id);
+            }
+        }
+
+        void operator()() { std::exchange(graph, nullptr)->execute_from(id); }
+    };
+
+    // Roots are ordinary submissions; nodes released from inside a node go
+    // past a bounded pool's limit, since a dropped one fails the whole run.
+    void schedule(node_id id, bool root) {
+        if (root) {
+            pool->execute(node_token(this, id));
+        } else {
+            pool->post_internal(function_wapper(node_token(this, id)));
+        }
+    }
+
+    // Counts down id and every successor it alone releases, without running
+    // them.
+    void skip_from(node_id id) {
+        std::vector<node_id> released{id};
+        while (!released.empty()) {
+            node &current = *nodes[released.back()];
+            released.pop_back();
+            for (node_id successor: current.successors) {
+                if (nodes[successor]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    released.push_back(successor);
+                }
+            }
+            finished->count_down();
+        }
+    }
+
+    // Run id, then keep going on this thread with one of the successors it
+    // released (its inputs are still in cache); the others go to the pool.
+    void execute_from(node_id id) {
+        while (true) {
+            node &current = *nodes[id];
+            if (!finished->failed()) {
+                try {
+                    current.fn();
+                } catch (...) {
+                    finished->set_exception(std::current_exception());
+                }
+            }
+            std::optional<node_id> next;
+            for (node_id successor: current.successors) {
+                if (nodes[successor]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    if (next) {
+                        schedule(*next, false);
+                    }
+                    next = successor;
+                }
+            }
+            finished->count_down();
+            if (!next) {
+                return;
+            }
+            id = *next;
+        }
+    }
+
+public:
+    task_graph() = default;
+
+    task_graph(const task_graph &) = delete;
+
+    task_graph &operator=(const task_graph &) = delete;
+
+    template<typename F>
+    node_id add_node(F &&fn) {
+        auto n = std::make_unique<node>();
+        n->fn = function_wapper(std::forward<F>(fn));
+        nodes.push_back(std::move(n));
+        return nodes.size() - 1;
+    }
+
+    // to will not start before from has finished.
+    void add_edge(node_id from, node_id to) {
+        if (from >= nodes.size() || to >= nodes.size()) {
+            throw std::out_of_range("task_graph::add_edge: unknown node");
+        }
+        nodes[from]->successors.push_back(to);
+        ++nodes[to]->predecessor_count;
+        validated = false;
+    }
+
+    size_t size() const { return nodes.size(); }
+
+    // Runs every node once and returns when all have finished or been
+    // skipped. The first exception is rethrown, including task_rejected or
+    // task_cancelled for a node the pool dropped; nodes after a failure are
+    // skipped. Called from a
+    // worker of the same pool, the caller runs queued work while it waits.
+    void run(thread_pool &executor) {
+        if (!validated) {
+            validate();
+        }
+        if (nodes.empty()) {
+            return;
+        }
+        pool = &executor;
+        finished.emplace(static_cast<std::ptrdiff_t>(nodes.size()));
+        for (auto &n: nodes) {
+            n->pending.store(n->predecessor_count, std::memory_order_relaxed);
+        }
+        for (node_id i = 0; i < nodes.size(); ++i) {
+            if (nodes[i]->predecessor_count == 0) {
+                schedule(i, true);
+            }
+        }
+        executor.wait_and_help(*finished);
+    }
+};
+
+#endif //CPP_CONCURRENCY_TASK_GRAPH_H
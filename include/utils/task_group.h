@@ -0,0 +1,141 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_TASK_GROUP_H
+#define CPP_CONCURRENCY_TASK_GROUP_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+#include "thread_pool.h"
+
+// Fork-join scope for recursive parallelism: run() spawns children, wait()
+// returns once all of them have finished. Children carry no future; the group
+// counts them with one atomic. wait() keeps running queued work meanwhile,
+// starting with the caller's own deque, which is where a worker's children
+// sit until someone steals them. Groups nest: a child may open its own group.
+//
+// The first exception thrown by a child is rethrown from wait(). It also
+// cancels the group: children that have not started yet are skipped, and
+// running ones can poll is_canceling().
+class task_group {
+private:
+    // Top bit of pending: wait() is asleep on it, so the last child must wake it.
+    static constexpr uint32_t sleeping = 1u << 31;
+    static constexpr uint32_t count_mask = sleeping - 1;
+
+    thread_pool &pool;
+    // Unfinished children; also the futex word wait() sleeps on.
+    std::atomic<uint32_t> pending{0};
+    std::atomic<bool> canceling{false};
+    std::atomic<bool> has_error{false};
+    std::exception_ptr error;
+
+    // Owned by a child task; if the pool drops the task unrun (shutdown with
+    // cancel, a full queue), the child still finishes, with task_cancelled.
+    class child_token {
+    private:
+        task_group *group;
+
+    public:
+        explicit child_token(task_group *group_) : group(group_) {}
+
+        child_token(child_token &&other) noexcept : group(std::exchange(other.group, nullptr)) {}
+
+        child_token &operator=(child_token &&) = delete;
+
+        ~child_token() {
+            if (group) {
+                group->fail(cancellation_scope::active() ? cancellation_scope::error()
+                                                         : std::make_exception_ptr(task_cancelled()));
+                group->finish_child();
+            }
+        }
+
+        task_group *take() { return std::exchange(group, nullptr); }
+    };
+
+    void fail(std::exception_ptr e) {
+        bool expected = false;
+        if (has_error.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            error = std::move(e);
+        }
+        canceling.store(true, std::memory_order_release);
+    }
+
+    void finish_child() {
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == (sleeping | 1)) {
+            futex_wake(pending, INT_MAX);
+        }
+    }
+
+    bool done() const { return (pending.load(std::memory_order_acquire) & count_mask) == 0; }
+
+    void timed_wait(std::chrono::nanoseconds timeout) {
+        const uint32_t current = pending.fetch_or(sleeping, std::memory_order_acq_rel) | sleeping;
+        if (current != sleeping) {
+            futex_wait_for(pending, current, timeout);
+        }
+    }
+
+public:
+    explicit task_group(thread_pool &pool_) : pool(pool_) {}
+
+    task_group(const task_group &) = delete;
+
+    task_group &operator=(const task_group &) = delete;
+
+    // Waits for children still running; their errors are dropped.
+    ~task_group() {
+        if (!done()) {
+            try {
+                wait();
+            } catch (...) {
+            }
+        }
+    }
+
+    template<typename F>
+    void run(F &&fn) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        pool.execute([token = child_token(this), fn = std::forward<F>(fn)]() mutable {
+            task_group *const group = token.take();
+            if (!group->is_canceling()) {
+                try {
+                    fn();
+                } catch (...) {
+                    group->fail(std::current_exception());
+                }
+            }
+            group->finish_child();
+        });
+    }
+
+    // Returns when every child has finished, running queued work meanwhile.
+    // Rethrows the first child exception; the group can then be reused.
+    void wait() {
+        pool.help_until([this] { return done(); }, [this](std::chrono::nanoseconds t) { timed_wait(t); });
+        // Every child has finished, so nothing else writes the state now.
+        if (pending.load(std::memory_order_relaxed) & sleeping) {
+            pending.fetch_and(count_mask, std::memory_order_relaxed);
+        }
+        canceling.store(false, std::memory_order_relaxed);
+        if (has_error.load(std::memory_order_acquire)) {
+            has_error.store(false, std::memory_order_relaxed);
+            std::rethrow_exception(std::exchange(error, nullptr));
+        }
+    }
+
+    // Children that have not started are skipped; wait() still waits for the
+    // running ones.
+    void cancel() { canceling.store(true, std::memory_order_release); }
+
+    bool is_canceling() const { return canceling.load(std::memory_order_acquire); }
+};
+
+#endif //CPP_CONCURRENCY_TASK_GROUP_H
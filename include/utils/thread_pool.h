@@ -5,113 +5,1765 @@
 #ifndef CPP_CONCURRENCY_THREAD_POOL_H
 #define CPP_CONCURRENCY_THREAD_POOL_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <fstream>
 #include <functional>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <tuple>
 #include <thread>
-#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <vector>
 
 #include "jthread.h"
+#include "function_wapper.h"
+#include "idle_strategy.h"
+#include "task_future.h"
+#include "latch.h"
+#include "pool_stats.h"
+#include "pool_trace.h"
+#include "timer_service.h"
+#include "topology.h"
 #include "data_structure/threadsafe_queue.h"
 #include "data_structure/threadsafe_queue_linkedlist.h"
+#include "data_structure/work_stealing_queue.h"
 
-class function_wapper {
+// The coroutine layer (utils/coroutine_task.h) only exists when the translation
+// unit is built as C++20; C++17 users see the pool exactly as before.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define CPP_CONCURRENCY_HAS_COROUTINES 1
+#else
+#define CPP_CONCURRENCY_HAS_COROUTINES 0
+#endif
+
+// How parallel_for hands out [begin, end):
+//   static_chunks  - one contiguous slice per participant, decided up front
+//   dynamic_chunks - participants repeatedly claim grain-sized chunks
+//   guided_chunks  - claimed chunks shrink with the remaining work, never below grain
+enum class loop_schedule { static_chunks, dynamic_chunks, guided_chunks };
+
+enum class task_priority { high, normal, low };
+
+// What thread_pool::shutdown does with tasks still queued:
+//   drain  - run them, and whatever they spawn, before the workers exit
+//   cancel - request a stop on the pool's stop token, let running tasks
+//            finish and drop the queued ones; their futures get task_cancelled
+enum class shutdown_mode { drain, cancel };
+
+// What a submission from outside the pool does once queue_capacity tasks are
+// waiting in the injection lanes and worker inboxes:
+//   block       - wait for room
+//   reject      - drop the task; its future gets task_rejected
+//   caller_runs - run the task on the submitting thread
+//   drop_oldest - drop the oldest task of the same lane (its future gets
+//                 task_rejected), else of any lane, and queue the new one
+// try_submit and try_execute never wait; they fail under every policy.
+// Strands, actors, fibers, timers and pipelines queue their own follow-up
+// tasks past the limit; no policy drops those.
+enum class overflow_policy { block, reject, caller_runs, drop_oldest };
+
+// Held by a queued task that a latch counts. If the task is dropped without
+// running (shutdown(cancel), or a full queue), the latch opens with
+// task_cancelled or task_rejected so its waiter does not hang.
+template<typename LatchPtr>
+class latch_guard {
 private:
-    struct impl_base {
-        virtual void call() = 0;
+    LatchPtr latch;
+    bool armed = true;
 
-        virtual ~impl_base() = default;;
-    };
+public:
+    explicit latch_guard(LatchPtr latch_) : latch(std::move(latch_)) {}
 
-    std::unique_ptr<impl_base> impl;
+    latch_guard(latch_guard &&other) noexcept
+        : latch(std::move(other.latch)), armed(std::exchange(other.armed, false)) {}
 
-    template<typename F>
-    struct impl_type : impl_base {
-        F f;
+    latch_guard &operator=(latch_guard &&) = delete;
+
+    ~latch_guard() {
+        if (armed) {
+            latch->abort(cancellation_scope::active() ? cancellation_scope::error()
+                                                      : std::make_exception_ptr(task_cancelled()));
+        }
+    }
+
+    // The task is running: from here on it counts the latch down itself.
+    countdown_latch &disarm() {
+        armed = false;
+        return *latch;
+    }
+};
+
+struct lane_stats {
+    size_t depth = 0;
+    uint64_t dequeued = 0;
+    std::chrono::nanoseconds total_wait{0};
+    std::chrono::nanoseconds max_wait{0};
+};
+
+struct backpressure_stats {
+    // 0 when the pool is unbounded; the rest then stays 0 as well.
+    size_t capacity = 0;
+    size_t queued = 0;
+    // Refused by the reject policy or by try_submit / try_execute.
+    uint64_t rejected = 0;
+    // Queued tasks dropped by drop_oldest.
+    uint64_t dropped = 0;
+    uint64_t ran_on_caller = 0;
+    // Submissions that had to wait for room, and how long they waited in all.
+    uint64_t blocked = 0;
+    std::chrono::nanoseconds blocked_time{0};
+};
+
+// Capacity shared by all injection lanes of a bounded pool. A slot is taken
+// before a task is pushed to a lane and given back when a worker pops it.
+class queue_bound {
+private:
+    std::atomic<size_t> queued{0};
+
+public:
+    const size_t capacity;
+    const overflow_policy policy;
+    // Submitters waiting under overflow_policy::block sleep here.
+    event_count room;
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> ran_on_caller{0};
+    std::atomic<uint64_t> blocked{0};
+    std::atomic<int64_t> blocked_ns{0};
+
+    queue_bound(size_t capacity_, overflow_policy policy_) : capacity(capacity_), policy(policy_) {}
+
+    // Takes up to count slots; returns how many it got.
+    size_t try_acquire(size_t count = 1) {
+        size_t current = queued.load(std::memory_order_relaxed);
+        size_t granted;
+        do {
+            if (current >= capacity) {
+                return 0;
+            }
+            granted = std::min(count, capacity - current);
+        } while (!queued.compare_exchange_weak(current, current + granted, std::memory_order_relaxed));
+        return granted;
+    }
 
-        explicit impl_type(F &&f_) : f(std::move(f_)) {}
+    // For tasks queued regardless of the limit (spawned by workers).
+    void acquire(size_t count) { queued.fetch_add(count, std::memory_order_relaxed); }
 
-        void call() override { f(); }
+    void release(size_t count) {
+        queued.fetch_sub(count, std::memory_order_relaxed);
+        if (count == 1) {
+            room.notify_one();
+        } else {
+            room.notify_all();
+        }
+    }
+
+    backpressure_stats stats() const {
+        backpressure_stats result;
+        result.capacity = capacity;
+        result.queued = queued.load(std::memory_order_relaxed);
+        result.rejected = rejected.load(std::memory_order_relaxed);
+        result.dropped = dropped.load(std::memory_order_relaxed);
+        result.ran_on_caller = ran_on_caller.load(std::memory_order_relaxed);
+        result.blocked = blocked.load(std::memory_order_relaxed);
+        result.blocked_time = std::chrono::nanoseconds(blocked_ns.load(std::memory_order_relaxed));
+        return result;
+    }
+};
+
+// One priority level of the injection queue. Tasks carry their enqueue time so
+// the lane can report how long work waits in it; depth is kept separately so
+// workers can skip an empty lane without touching its locks.
+class task_lane {
+private:
+    struct timed_task {
+        function_wapper task;
+        std::chrono::steady_clock::time_point enqueued;
+        // Queued by the pool's own machinery; drop_oldest passes it over.
+        bool pinned = false;
     };
 
+    threadsafe_queue<timed_task> queue;
+    std::atomic<size_t> depth{0};
+    std::atomic<uint64_t> dequeued{0};
+    std::atomic<int64_t> total_wait_ns{0};
+    std::atomic<int64_t> max_wait_ns{0};
+
 public:
-    template<class F>
-    explicit function_wapper(F &&f) : impl(new impl_type<F>(std::move(f))) {}
+    // Most tasks try_pop_batch hands out per call.
+    static constexpr size_t max_batch = 16;
 
-    void operator()() { impl->call(); }
+    // Times a lower lane was passed over while it had work (see aging_limit).
+    std::atomic<unsigned> skipped{0};
+    // Set on every lane of a bounded pool; popped tasks give their slot back.
+    queue_bound *bound = nullptr;
 
-    function_wapper() = default;
+    void push(function_wapper task, bool pinned = false) {
+        depth.fetch_add(1, std::memory_order_relaxed);
+        queue.push(timed_task{std::move(task), std::chrono::steady_clock::now(), pinned});
+    }
 
-    function_wapper(function_wapper &&other) noexcept : impl(std::move(other.impl)) {}
+    template<typename Iterator>
+    void push_batch(Iterator first, Iterator last) {
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<timed_task> batch;
+        batch.reserve(std::distance(first, last));
+        for (; first != last; ++first) {
+            batch.push_back(timed_task{std::move(*first), now});
+        }
+        depth.fetch_add(batch.size(), std::memory_order_relaxed);
+        queue.push_batch(batch.begin(), batch.end());
+    }
 
-    function_wapper &operator=(function_wapper &&other) noexcept {
-        impl = std::move(other.impl);
-        return *this;
+    bool try_pop(function_wapper &task) {
+        return try_pop_batch(&task, 1) == 1;
     }
 
-    function_wapper(const function_wapper &other) = delete;
+    // Up to max_count tasks with one queue lock, written to out[0..n).
+    size_t try_pop_batch(function_wapper *out, size_t max_count) {
+        if (depth.load(std::memory_order_relaxed) == 0) {
+            return 0;
+        }
+        std::array<timed_task, max_batch> entries;
+        const size_t count = queue.try_pop_batch(entries.begin(), std::min(max_count, max_batch));
+        if (count == 0) {
+            return 0;
+        }
+        depth.fetch_sub(count, std::memory_order_relaxed);
+        if (bound) {
+            bound->release(count);
+        }
+        const auto now = std::chrono::steady_clock::now();
+        int64_t total = 0;
+        int64_t longest = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const int64_t waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - entries[i].enqueued).count();
+            total += waited;
+            longest = std::max(longest, waited);
+            out[i] = std::move(entries[i].task);
+        }
+        dequeued.fetch_add(count, std::memory_order_relaxed);
+        total_wait_ns.fetch_add(total, std::memory_order_relaxed);
+        int64_t max = max_wait_ns.load(std::memory_order_relaxed);
+        while (longest > max && !max_wait_ns.compare_exchange_weak(max, longest, std::memory_order_relaxed)) {
+        }
+        return count;
+    }
+
+    // The oldest task that is not pinned, for drop_oldest. Pinned tasks it
+    // passes over go to the back of the lane; each is looked at once.
+    bool try_pop_unpinned(function_wapper &task) {
+        for (size_t n = size(); n > 0; --n) {
+            timed_task entry;
+            if (!queue.try_pop(entry)) {
+                return false;
+            }
+            if (entry.pinned) {
+                queue.push(std::move(entry));
+                continue;
+            }
+            depth.fetch_sub(1, std::memory_order_relaxed);
+            if (bound) {
+                bound->release(1);
+            }
+            task = std::move(entry.task);
+            return true;
+        }
+        return false;
+    }
 
-    function_wapper(function_wapper &other) = delete;
+    bool empty() const { return depth.load(std::memory_order_relaxed) == 0; }
 
-    function_wapper &operator=(const function_wapper &other) = delete;
+    size_t size() const { return depth.load(std::memory_order_relaxed); }
+
+    lane_stats stats() const {
+        lane_stats result;
+        result.depth = depth.load(std::memory_order_relaxed);
+        result.dequeued = dequeued.load(std::memory_order_relaxed);
+        result.total_wait = std::chrono::nanoseconds(total_wait_ns.load(std::memory_order_relaxed));
+        result.max_wait = std::chrono::nanoseconds(max_wait_ns.load(std::memory_order_relaxed));
+        return result;
+    }
 };
 
+// Tasks sent to one worker (thread_pool::submit_on / submit_local). The owner
+// takes them first-in first-out ahead of the shared lanes; other workers only
+// take a task once it has waited past a deadline, so a busy owner does not
+// hold it up for long.
+class worker_inbox {
+private:
+    struct entry {
+        function_wapper task;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    std::mutex mutex;
+    std::deque<entry> entries;
+    // Lets callers skip an empty inbox without taking the lock.
+    std::atomic<size_t> depth{0};
+
+public:
+    // Set on every inbox of a bounded pool; like a lane, a taken task gives
+    // its slot back.
+    queue_bound *bound = nullptr;
+
+    void push(function_wapper task) {
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard lock(mutex);
+        entries.push_back(entry{std::move(task), now});
+        depth.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    // Owner only.
+    bool try_pop(function_wapper &task) {
+        return try_steal(task, std::chrono::steady_clock::time_point::max());
+    }
+
+    // The oldest task, if it was queued no later than not_after.
+    bool try_steal(function_wapper &task, std::chrono::steady_clock::time_point not_after) {
+        if (empty()) {
+            return false;
+        }
+        std::lock_guard lock(mutex);
+        if (entries.empty() || entries.front().enqueued > not_after) {
+            return false;
+        }
+        task = std::move(entries.front().task);
+        entries.pop_front();
+        depth.fetch_sub(1, std::memory_order_relaxed);
+        if (bound) {
+            bound->release(1);
+        }
+        return true;
+    }
+
+    bool empty() const { return depth.load(std::memory_order_seq_cst) == 0; }
+};
+
+struct thread_pool_options {
+    unsigned thread_count = std::thread::hardware_concurrency();
+    // Give every worker its own deque and let idle workers steal from each
+    // other. When off, all tasks go through the single shared queue.
+    bool work_stealing = true;
+    idle_policy idle;
+    // A lower-priority lane that has been passed over this many times while
+    // holding work is served next, so low-priority tasks cannot starve.
+    unsigned aging_limit = 32;
+    // Pin worker i to the i-th CPU of cpu_topology::placement_order().
+    bool pin_threads = false;
+    // Pin workers and give every NUMA node its own injection lanes. Workers
+    // serve and steal from their own node before touching another one, and
+    // outside submissions go to the node of the CPU they are made on.
+    bool numa_aware = false;
+    // Defaults to the topology read from sysfs, limited to the CPUs this
+    // process may use.
+    std::optional<cpu_topology> topology;
+    // Elastic sizing: thread_count workers start, and the pool keeps between
+    // min_threads and max_threads (0 = thread_count, i.e. a fixed size). A
+    // worker is added when a task is queued while every worker is busy (at
+    // most one per grow_interval) or when a worker enters a blocking region;
+    // workers above min_threads exit after parking for idle_timeout.
+    unsigned min_threads = 0;
+    unsigned max_threads = 0;
+    std::chrono::milliseconds idle_timeout{200};
+    std::chrono::microseconds grow_interval{500};
+    // With THREAD_POOL_ENABLE_STATS, print stats() to std::clog this often
+    // (0 = never).
+    std::chrono::milliseconds stats_interval{0};
+    // Most tasks the injection lanes and worker inboxes hold for submitters
+    // outside the pool (0 = unbounded), and what happens beyond that. Tasks spawned by workers
+    // are never held back, since a worker waiting on its own pool can
+    // deadlock, but they do take up room.
+    size_t queue_capacity = 0;
+    overflow_policy overflow = overflow_policy::block;
+    // With THREAD_POOL_ENABLE_TRACING, the most recent task events each worker
+    // keeps (rounded up to a power of two).
+    size_t trace_events_per_worker = 1 << 16;
+    // How long a task sent to one worker (submit_on, submit_local) is left to
+    // it before idle workers may take it instead.
+    std::chrono::microseconds affinity_steal_delay{100};
+};
+
+struct worker_placement {
+    unsigned worker = 0;
+    // -1 when the worker is not pinned.
+    int cpu = -1;
+    unsigned node = 0;
+    bool pinned = false;
+};
 
 class thread_pool {
 private:
+    // Waits through help_until.
+    friend class task_group;
+    // Reschedule themselves through post_internal.
+    friend class strand;
+    template<typename Message> friend class actor;
+    friend class fiber;
+    friend class pipeline_run;
+    friend class task_graph;
+
+    // Executor of the pool's own timers: a due timer is queued with
+    // post_internal, so a full queue cannot drop or delay it.
+    struct internal_executor {
+        thread_pool &pool;
+
+        template<typename F>
+        void execute(F &&f) { pool.post_internal(function_wapper(std::forward<F>(f))); }
+    };
+
+    using local_queue_type = work_stealing_queue<function_wapper>;
+
     std::atomic<bool> done;
-    threadsafe_queue<function_wapper> work_queue;
-    // threadsafe_queue<std::function<void()>> work_queue;
+    // Set by shutdown(cancel): workers stop taking tasks.
+    std::atomic<bool> cancelling{false};
+    stop_source stopper;
+    std::mutex shutdown_mutex;
+    bool shut_down = false;
+    // Started by the first schedule_after / schedule_every.
+    std::once_flag timers_started;
+    internal_executor timer_executor{*this};
+    std::unique_ptr<timer_service<internal_executor>> timers;
+    const bool work_stealing;
+    const idle_policy idle;
+    // Parked workers sleep here; submit wakes one only if somebody is parked.
+    event_count work_available;
+    const unsigned aging_limit;
+    // Injection queue, one lane per task_priority: submissions from threads that
+    // are not workers of this pool, and every high/low priority submission.
+    // There is one set of lanes per NUMA node when numa_aware is on.
+    using lane_set = std::array<task_lane, 3>;
+    std::vector<lane_set> node_lanes;
+    // Null unless queue_capacity is set.
+    std::unique_ptr<queue_bound> bound;
+    std::vector<worker_placement> placements;
+    // Node of each CPU id, used to route submissions from outside the pool.
+    std::vector<unsigned> cpu_node;
+    std::vector<std::unique_ptr<local_queue_type>> queues;
+    // Elastic sizing. Every per-worker vector has max_threads slots up front;
+    // a retired worker's slot is reused by the next one started.
+    const unsigned min_threads;
+    const unsigned max_threads;
+    const std::chrono::nanoseconds idle_timeout;
+    const std::chrono::nanoseconds grow_interval;
+    std::atomic<unsigned> live_workers{0};
+    std::atomic<unsigned> idle_workers{0};
+    std::atomic<int64_t> last_grow{0};
+    std::unique_ptr<std::atomic<bool>[]> slot_active;
+    mutable std::mutex grow_mutex;
+    // Affinity tasks, one inbox per worker slot; parked marks a worker asleep
+    // in wait_for_task, which a task sent to it has to wake.
+    const std::chrono::nanoseconds affinity_steal_delay;
+    std::unique_ptr<worker_inbox[]> inboxes;
+    std::unique_ptr<std::atomic<bool>[]> parked;
+#if THREAD_POOL_ENABLE_STATS
+    std::unique_ptr<worker_counters[]> counters;
+    std::thread stats_reporter;
+    std::mutex stats_mutex;
+    std::condition_variable stats_stop;
+    inline static thread_local int64_t last_task_end = 0;
+#endif
+#if THREAD_POOL_ENABLE_TRACING
+    std::vector<std::unique_ptr<trace_ring>> rings;
+    trace_calibration trace_epoch;
+#endif
     std::vector<std::thread> threads;
     jthreads joiner;
 
-    void work_thread() {
-        while (!done) {
+    inline static thread_local thread_pool *current_pool = nullptr;
+    inline static thread_local local_queue_type *local_work_queue = nullptr;
+    inline static thread_local unsigned my_index = 0;
+    inline static thread_local unsigned my_node = 0;
+    inline static thread_local unsigned steal_seed = 0;
+
+    void work_thread(unsigned index) {
+        current_pool = this;
+        my_index = index;
+        my_node = placements[index].node;
+        local_work_queue = work_stealing ? queues[index].get() : nullptr;
+        steal_seed = index * 2654435761u + 1;
+#if THREAD_POOL_ENABLE_STATS
+        last_task_end = stats_clock();
+#endif
+        unsigned idle_rounds = 0;
+        bool is_idle = false;
+        while (!cancelling.load(std::memory_order_relaxed)) {
             function_wapper task;
-            // std::function<void()> task;
-            if (work_queue.try_pop(task)) {
-                task();
+            if (try_pop_task(task)) {
+                if (is_idle) {
+                    idle_workers.fetch_sub(1, std::memory_order_relaxed);
+                    is_idle = false;
+                }
+                idle_rounds = 0;
+                run_task(task);
             } else {
-                std::this_thread::yield();
+                // Shutting down and nothing left that this worker can see.
+                if (done) {
+                    break;
+                }
+                if (!is_idle) {
+                    idle_workers.fetch_add(1, std::memory_order_relaxed);
+                    is_idle = true;
+                }
+                if (!wait_for_task(idle_rounds)) {
+                    break;
+                }
             }
         }
+        if (is_idle) {
+            idle_workers.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool elastic() const { return max_threads > min_threads; }
+
+    // Runs a task popped by work_thread. With stats on, the time since the
+    // previous task counts as idle and this one as busy.
+    void run_task(function_wapper &task) {
+#if THREAD_POOL_ENABLE_STATS
+        worker_counters &c = counters[my_index];
+        const int64_t start = stats_clock();
+        worker_counters::add(c.idle_ns, start - last_task_end);
+        if (c.tasks_executed.load(std::memory_order_relaxed) % worker_counters::depth_sample_period == 0) {
+            c.sample_depth(current_depth());
+        }
+        run_traced(task);
+        last_task_end = stats_clock();
+        worker_counters::add(c.busy_ns, last_task_end - start);
+#else
+        run_traced(task);
+#endif
+    }
+
+    // Workers of this pool only.
+    void run_traced(function_wapper &task) {
+#if THREAD_POOL_ENABLE_TRACING
+        const uint64_t begin = trace_clock::now();
+        task();
+        rings[my_index]->record(begin, trace_clock::now());
+#else
+        task();
+#endif
+    }
+
+#if THREAD_POOL_ENABLE_STATS
+    static int64_t stats_clock() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+
+    worker_counters *my_counters() const { return current_pool == this ? &counters[my_index] : nullptr; }
+
+    uint64_t current_depth() {
+        uint64_t depth = local_work_queue ? local_work_queue->size() : 0;
+        for (auto priority: {task_priority::high, task_priority::normal, task_priority::low}) {
+            depth += lane(priority).stats().depth;
+        }
+        return depth;
+    }
+
+    // Every queued task carries its enqueue time; the wrapper books queueing
+    // delay and run time on whichever worker of this pool runs it.
+    function_wapper stamp(function_wapper task) {
+        return function_wapper([this, inner = std::move(task), enqueued = stats_clock()]() mutable {
+            const int64_t start = stats_clock();
+            inner();
+            if (worker_counters *c = my_counters()) {
+                worker_counters::add(c->queue_latency[latency_histogram::bucket_of(start - enqueued)]);
+                worker_counters::add(c->run_latency[latency_histogram::bucket_of(stats_clock() - start)]);
+                worker_counters::add(c->tasks_executed);
+            }
+        });
+    }
+
+    void report_stats(std::chrono::milliseconds interval) {
+        std::unique_lock lock(stats_mutex);
+        while (!stats_stop.wait_for(lock, interval, [this] { return done.load(); })) {
+            std::clog << stats();
+        }
+    }
+#else
+    static function_wapper stamp(function_wapper task) { return task; }
+#endif
+
+    // Spin with a pause hint, then yield, then park until submit signals new
+    // work. Returns false when the worker should exit: it is above min_threads
+    // in an elastic pool and stayed parked for idle_timeout.
+    bool wait_for_task(unsigned &idle_rounds) {
+        if (idle_rounds < idle.spin_count) {
+            ++idle_rounds;
+            cpu_relax();
+            return true;
+        }
+        if (!idle.park || idle_rounds - idle.spin_count < idle.yield_count) {
+            if (idle.park) {
+                ++idle_rounds;
+            }
+            std::this_thread::yield();
+            return true;
+        }
+        parked[my_index].store(true, std::memory_order_seq_cst);
+        const uint32_t key = work_available.prepare_wait();
+        // Another worker's affinity task becomes ours to take after a delay;
+        // nobody will notify us then, so only sleep that long.
+        const bool foreign_affinity = has_inbox_task();
+        bool retire = false;
+        if (done || has_pending_task()) {
+            work_available.cancel_wait();
+        } else if (foreign_affinity) {
+            work_available.commit_wait_for(key, affinity_steal_delay);
+        } else if (!elastic()) {
+            work_available.commit_wait(key);
+        } else {
+            retire = !work_available.commit_wait_for(key, idle_timeout) && try_retire();
+        }
+        parked[my_index].store(false, std::memory_order_relaxed);
+        idle_rounds = 0;
+        return !retire;
+    }
+
+    // The worker's deque is empty here: it just failed to pop from it, and
+    // only the owner pushes to it.
+    bool try_retire() {
+        unsigned live = live_workers.load(std::memory_order_relaxed);
+        do {
+            if (live <= min_threads || done) {
+                return false;
+            }
+        } while (!live_workers.compare_exchange_weak(live, live - 1, std::memory_order_relaxed));
+        slot_active[my_index].store(false, std::memory_order_release);
+        return true;
+    }
+
+    void start_worker(unsigned index) {
+        if (threads[index].joinable()) {
+            threads[index].join();
+        }
+        slot_active[index].store(true, std::memory_order_release);
+        threads[index] = std::thread(&thread_pool::work_thread, this, index);
+        if (placements[index].cpu >= 0) {
+            placements[index].pinned = pin_thread_to_cpu(threads[index], placements[index].cpu);
+        }
+    }
+
+    // Add a worker if every live one is busy. Called after queueing a task
+    // (rate limited by grow_interval) and, unlimited, on entering a blocking
+    // region.
+    void maybe_grow(bool compensate) {
+        if (idle_workers.load(std::memory_order_relaxed) != 0 ||
+            live_workers.load(std::memory_order_relaxed) >= max_threads) {
+            return;
+        }
+        const int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        if (!compensate && now - last_grow.load(std::memory_order_relaxed) < grow_interval.count()) {
+            return;
+        }
+        std::unique_lock lock(grow_mutex, std::try_to_lock);
+        if (!lock || done || live_workers.load(std::memory_order_relaxed) >= max_threads) {
+            return;
+        }
+        for (unsigned i = 0; i < max_threads; ++i) {
+            if (!slot_active[i].load(std::memory_order_acquire)) {
+                last_grow.store(now, std::memory_order_relaxed);
+                live_workers.fetch_add(1, std::memory_order_relaxed);
+                try {
+                    start_worker(i);
+                } catch (...) {
+                    // Out of threads: keep running with the workers we have.
+                    slot_active[i].store(false, std::memory_order_relaxed);
+                    live_workers.fetch_sub(1, std::memory_order_relaxed);
+                }
+                return;
+            }
+        }
+    }
+
+    bool has_pending_task() {
+        for (const auto &lanes: node_lanes) {
+            if (std::any_of(lanes.begin(), lanes.end(), [](const task_lane &lane) { return !lane.empty(); })) {
+                return true;
+            }
+        }
+        if (current_pool == this && !inboxes[my_index].empty()) {
+            return true;
+        }
+        return std::any_of(queues.begin(), queues.end(), [](const auto &q) { return !q->empty(); });
+    }
+
+    bool has_inbox_task() const {
+        for (unsigned i = 0; i < max_threads; ++i) {
+            if (!inboxes[i].empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    local_queue_type *own_local_queue() const {
+        return current_pool == this ? local_work_queue : nullptr;
+    }
+
+    unsigned node_count() const { return static_cast<unsigned>(node_lanes.size()); }
+
+    // Workers use their own node; other threads the node of the CPU they run on.
+    unsigned home_node() const {
+        if (current_pool == this) {
+            return my_node;
+        }
+        if (node_count() == 1) {
+            return 0;
+        }
+        const int cpu = current_cpu();
+        return cpu >= 0 && static_cast<size_t>(cpu) < cpu_node.size() ? cpu_node[cpu] : 0;
+    }
+
+    task_lane &lane(task_priority priority) { return lane(priority, home_node()); }
+
+    task_lane &lane(task_priority priority, unsigned node) {
+        return node_lanes[node][static_cast<size_t>(priority)];
+    }
+
+    // High lane, then normal work (own deque, normal lane, stealing), then low
+    // lane; a lane that aged past aging_limit goes first. Everything on the
+    // worker's own node is tried before work from other nodes.
+    bool try_pop_task(function_wapper &task) {
+        if (pop_task_from_aged_lane(task)) {
+            return true;
+        }
+        if (pop_task_from_lane(task_priority::high, task) || pop_task_from_inbox(task) ||
+            pop_task_from_local_queue(task) || pop_task_batch_from_normal_lane(task) ||
+            pop_task_from_other_thread_queue(task, true) || pop_task_from_other_inbox(task)) {
+            age_lanes_below(task_priority::normal);
+            return true;
+        }
+        if (node_count() > 1 && (pop_task_from_remote_lanes(task_priority::high, task) ||
+                                 pop_task_from_remote_lanes(task_priority::normal, task) ||
+                                 pop_task_from_other_thread_queue(task, false))) {
+            return true;
+        }
+        return pop_task_from_lane(task_priority::low, task) ||
+               (node_count() > 1 && pop_task_from_remote_lanes(task_priority::low, task));
+    }
+
+    bool pop_task_from_remote_lanes(task_priority priority, function_wapper &task) {
+        const unsigned own = home_node();
+        for (unsigned i = 1; i < node_count(); ++i) {
+            if (lane(priority, (own + i) % node_count()).try_pop(task)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool pop_task_from_aged_lane(function_wapper &task) {
+        for (auto priority: {task_priority::low, task_priority::normal}) {
+            task_lane &l = lane(priority);
+            if (l.skipped.load(std::memory_order_relaxed) >= aging_limit && l.try_pop(task)) {
+                l.skipped.store(0, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool pop_task_from_lane(task_priority priority, function_wapper &task) {
+        if (!lane(priority).try_pop(task)) {
+            return false;
+        }
+        if (priority == task_priority::high) {
+            age_lanes_below(task_priority::high);
+        }
+        return true;
+    }
+
+    // A worker takes up to its share of the normal lane (depth / workers, at
+    // most task_lane::max_batch) with one lock: it runs the first task and
+    // moves the rest to its own deque, where idle workers can still steal
+    // them. Other threads take one task at a time.
+    bool pop_task_batch_from_normal_lane(function_wapper &task) {
+        task_lane &l = lane(task_priority::normal);
+        local_queue_type *const local = own_local_queue();
+        const size_t share = local ? l.size() / std::max(1u, size()) : 1;
+        if (share <= 1) {
+            return pop_task_from_lane(task_priority::normal, task);
+        }
+        std::array<function_wapper, task_lane::max_batch> batch;
+        const size_t count = l.try_pop_batch(batch.data(), share);
+        if (count == 0) {
+            return false;
+        }
+        task = std::move(batch[0]);
+        local->push_batch(batch.begin() + 1, batch.begin() + count);
+        return true;
+    }
+
+    void age_lanes_below(task_priority priority) {
+        lane_set &lanes = node_lanes[home_node()];
+        for (size_t i = static_cast<size_t>(priority) + 1; i < lanes.size(); ++i) {
+            if (!lanes[i].empty()) {
+                lanes[i].skipped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop_task_from_inbox(function_wapper &task) {
+        return current_pool == this && inboxes[my_index].try_pop(task);
+    }
+
+    // Affinity tasks that have waited past affinity_steal_delay, or any once
+    // the pool is shutting down so draining does not wait on them.
+    bool pop_task_from_other_inbox(function_wapper &task) {
+        const unsigned own = current_pool == this ? my_index : max_threads;
+        std::optional<std::chrono::steady_clock::time_point> not_after;
+        for (unsigned i = 0; i < max_threads; ++i) {
+            if (i == own || inboxes[i].empty()) {
+                continue;
+            }
+            if (!not_after) {
+                not_after = done.load(std::memory_order_relaxed)
+                            ? std::chrono::steady_clock::time_point::max()
+                            : std::chrono::steady_clock::now() - affinity_steal_delay;
+            }
+            if (inboxes[i].try_steal(task, *not_after)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool pop_task_from_local_queue(function_wapper &task) {
+        local_queue_type *const local = own_local_queue();
+        return local && local->try_pop(task);
+    }
+
+    // Start at a random victim so idle workers don't all hammer the same deque.
+    // same_node picks victims on the caller's node, otherwise on other nodes.
+    bool pop_task_from_other_thread_queue(function_wapper &task, bool same_node) {
+        const auto count = static_cast<unsigned>(queues.size());
+        if (!work_stealing || count == 0) {
+            return false;
+        }
+        if (steal_seed == 0) {
+            // An outside thread helping in wait_and_help; xorshift would stay
+            // at 0 and always start from the same victim.
+            steal_seed = static_cast<unsigned>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1u;
+        }
+        steal_seed ^= steal_seed << 13;
+        steal_seed ^= steal_seed >> 17;
+        steal_seed ^= steal_seed << 5;
+        const unsigned start = steal_seed % count;
+        for (unsigned i = 0; i < count; ++i) {
+            const unsigned index = (start + i) % count;
+            if ((placements[index].node == home_node()) != same_node ||
+                !slot_active[index].load(std::memory_order_relaxed)) {
+                continue;
+            }
+            if (queues[index].get() == own_local_queue()) {
+                continue;
+            }
+            const bool stolen = queues[index]->try_steal(task);
+#if THREAD_POOL_ENABLE_STATS
+            if (worker_counters *c = my_counters()) {
+                worker_counters::add(c->steal_attempts);
+                worker_counters::add(c->steal_successes, stolen);
+            }
+#endif
+            if (stolen) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Bound arguments are stored by value and passed as lvalues, like std::bind.
+    // Without arguments only the callable is captured, to keep the task small
+    // enough for function_wapper's inline storage.
+    template<typename R, typename F, typename ...Args>
+    static function_wapper make_task(task_promise<R> promise, F &&f, Args &&...args) {
+        if constexpr (sizeof...(Args) == 0) {
+            return function_wapper([promise = std::move(promise), func = std::forward<F>(f)]() mutable {
+                promise.set_from(func);
+            });
+        } else {
+            return function_wapper([promise = std::move(promise), func = std::forward<F>(f),
+                                    bound = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                promise.set_from([&] { return std::apply(func, bound); });
+            });
+        }
+    }
+
+    // How a task from outside the pool gets its lane slot on a bounded pool.
+    //   policy   - through admit(), as the overflow policy says
+    //   reserved - the caller already holds one (try_reserve)
+    //   internal - over the limit if need be (post_internal)
+    enum class admission { policy, reserved, internal };
+
+    // Normal work spawned by a worker stays on that worker's deque; everything
+    // else goes through the lane of its priority.
+    void push_task(function_wapper task, task_priority priority = task_priority::normal,
+                   admission how = admission::policy) {
+        if (rejecting()) {
+            discard(std::move(task));
+            return;
+        }
+        task = stamp(std::move(task));
+        local_queue_type *const local = own_local_queue();
+        if (local && priority == task_priority::normal) {
+            local->push(std::move(task));
+        } else {
+            if (bound) {
+                if (current_pool == this || how == admission::internal) {
+                    bound->acquire(1);
+                } else if (how == admission::policy && !admit(task, priority)) {
+                    return;
+                }
+            }
+            lane(priority).push(std::move(task), how == admission::internal);
+        }
+        work_available.notify_one();
+        if (elastic()) {
+            maybe_grow(false);
+        }
+    }
+
+    // For tasks that carry the state of a strand, actor, fiber, timer or
+    // pipeline: whoever queued one counts on it running, so the overflow
+    // policy never applies to it. It is never refused, run on the caller,
+    // blocked on or picked by drop_oldest; only shutdown discards it.
+    void post_internal(function_wapper task, task_priority priority = task_priority::normal) {
+        push_task(std::move(task), priority, admission::internal);
+    }
+
+    void push_task_to(unsigned worker, function_wapper task) {
+        if (rejecting()) {
+            discard(std::move(task));
+            return;
+        }
+        if (!slot_active[worker].load(std::memory_order_acquire)) {
+            push_task(std::move(task));
+            return;
+        }
+        // Inboxes count against queue_capacity like the lanes.
+        if (bound) {
+            if (current_pool == this) {
+                bound->acquire(1);
+            } else if (!admit(task, task_priority::normal)) {
+                return;
+            }
+        }
+        inboxes[worker].push(stamp(std::move(task)));
+        // Somebody has to be awake to take it over after the delay; and if
+        // the target itself is asleep, notify_one may well pick another worker.
+        work_available.notify_one();
+        if (parked[worker].load(std::memory_order_relaxed)) {
+            work_available.notify_all();
+        }
+    }
+
+    // One queue operation for the whole batch.
+    void push_tasks(std::vector<function_wapper> &tasks) {
+        if (rejecting()) {
+            for (auto &task: tasks) {
+                discard(std::move(task));
+            }
+            return;
+        }
+#if THREAD_POOL_ENABLE_STATS
+        for (auto &task: tasks) {
+            task = stamp(std::move(task));
+        }
+#endif
+        if (local_queue_type *const local = own_local_queue()) {
+            local->push_batch(tasks.begin(), tasks.end());
+        } else {
+            size_t fits = tasks.size();
+            if (bound && current_pool == this) {
+                bound->acquire(fits);
+            } else if (bound) {
+                fits = bound->try_acquire(fits);
+            }
+            lane(task_priority::normal).push_batch(tasks.begin(), tasks.begin() + fits);
+            // Whatever did not fit goes through the overflow policy one by one.
+            for (size_t i = fits; i < tasks.size(); ++i) {
+                if (admit(tasks[i], task_priority::normal)) {
+                    lane(task_priority::normal).push(std::move(tasks[i]));
+                }
+            }
+        }
+        work_available.notify_all();
+        if (elastic()) {
+            maybe_grow(false);
+        }
+    }
+
+    // Bounded pools, outside submitters: takes a lane slot for task, or
+    // disposes of it as the overflow policy says and returns false.
+    bool admit(function_wapper &task, task_priority priority) {
+        if (bound->try_acquire() != 0) {
+            return true;
+        }
+        switch (bound->policy) {
+            case overflow_policy::block:
+                if (wait_for_room()) {
+                    return true;
+                }
+                discard(std::move(task));
+                return false;
+            case overflow_policy::reject:
+                bound->rejected.fetch_add(1, std::memory_order_relaxed);
+                discard(std::move(task), true);
+                return false;
+            case overflow_policy::caller_runs:
+                bound->ran_on_caller.fetch_add(1, std::memory_order_relaxed);
+                task();
+                return false;
+            case overflow_policy::drop_oldest:
+                drop_oldest(priority);
+                return true;
+        }
+        return true;
+    }
+
+    // False if the pool shut down meanwhile.
+    bool wait_for_room() {
+        const auto start = std::chrono::steady_clock::now();
+        bool admitted = false;
+        for (;;) {
+            const uint32_t key = bound->room.prepare_wait();
+            if (rejecting()) {
+                bound->room.cancel_wait();
+                break;
+            }
+            if (bound->try_acquire() != 0) {
+                bound->room.cancel_wait();
+                admitted = true;
+                break;
+            }
+            bound->room.commit_wait(key);
+        }
+        bound->blocked.fetch_add(1, std::memory_order_relaxed);
+        bound->blocked_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        return admitted;
+    }
+
+    // Non-blocking admission for try_submit / try_execute. Workers are never
+    // refused, and take their slot in push_task.
+    bool try_reserve() {
+        if (rejecting()) {
+            return false;
+        }
+        if (!bound || current_pool == this || bound->try_acquire() != 0) {
+            return true;
+        }
+        bound->rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Makes room by dropping queued tasks, oldest of the target lane first.
+    void drop_oldest(task_priority priority) {
+        constexpr task_priority order[] = {task_priority::low, task_priority::normal, task_priority::high};
+        while (bound->try_acquire() == 0) {
+            function_wapper victim;
+            bool found = lane(priority).try_pop_unpinned(victim);
+            for (size_t i = 0; !found && i < std::size(order); ++i) {
+                found = lane(order[i]).try_pop_unpinned(victim);
+            }
+            if (!found) {
+                // Workers took everything between our checks, or only
+                // internal tasks are queued; either way the task goes in.
+                bound->acquire(1);
+                return;
+            }
+            bound->dropped.fetch_add(1, std::memory_order_relaxed);
+            discard(std::move(victim), true);
+        }
+    }
+
+    // Null once shutdown has begun without any timer having been scheduled.
+    timer_service<internal_executor> *timer() {
+        std::call_once(timers_started, [this] {
+            timers = std::make_unique<timer_service<internal_executor>>(timer_executor);
+        });
+        return timers.get();
+    }
+
+    // After shutdown starts only tasks spawned by a draining worker are queued.
+    bool rejecting() const {
+        return done.load(std::memory_order_acquire) &&
+               (current_pool != this || cancelling.load(std::memory_order_relaxed));
+    }
+
+    static void discard(function_wapper task, bool rejected = false) {
+        cancellation_scope scope(rejected);
+        function_wapper dropped(std::move(task));
+    }
+
+    bool try_run_pending_task() {
+        function_wapper task;
+        if (try_pop_task(task)) {
+            task();
+            return true;
+        }
+        return false;
+    }
+
+    // Helping wait: the caller's own deque first (LIFO, the work it spawned
+    // most recently), then anything else it could take. With nothing to run
+    // it sleeps on the awaited object, waking every 50us..1ms (doubling) to
+    // pick up work that arrived meanwhile, since submit cannot wake it there.
+    // An elastic pool gets a compensating worker for the sleep.
+    template<typename Ready, typename TimedWait>
+    void help_until(Ready ready, TimedWait timed_wait) {
+        constexpr std::chrono::nanoseconds min_sleep = std::chrono::microseconds(50);
+        constexpr std::chrono::nanoseconds max_sleep = std::chrono::milliseconds(1);
+        std::chrono::nanoseconds sleep = min_sleep;
+        bool hinted = false;
+        while (!ready()) {
+            function_wapper task;
+            if (pop_task_from_local_queue(task) || try_pop_task(task)) {
+                if (current_pool == this) {
+                    run_traced(task);
+                } else {
+                    task();
+                }
+                sleep = min_sleep;
+                continue;
+            }
+            if (!hinted) {
+                blocking_region region(*this);
+                hinted = true;
+            }
+            timed_wait(sleep);
+            sleep = std::min(sleep * 2, max_sleep);
+        }
+    }
+
+    // Shared by every participant of one parallel_for call. Workers hold it
+    // through a shared_ptr, so a task that starts after the loop has finished
+    // only finds nothing left to claim.
+    template<typename Index>
+    struct loop_state {
+        std::atomic<Index> next;
+        const Index end;
+        const Index grain;
+        const unsigned participants;
+        const loop_schedule schedule;
+        void *const body;
+        void (*const run_range)(void *body, Index first, Index last);
+        // Counts items, not tasks: the caller returns as soon as every item is done.
+        countdown_latch remaining;
+
+        template<typename F>
+        loop_state(Index begin, Index end_, Index grain_, unsigned participants_, loop_schedule schedule_, F &fn)
+            : next(begin), end(end_), grain(grain_), participants(participants_), schedule(schedule_),
+              body(static_cast<void *>(&fn)), run_range([](void *b, Index first, Index last) {
+                  F &f = *static_cast<F *>(b);
+                  for (Index i = first; i < last; ++i) {
+                      f(i);
+                  }
+              }), remaining(static_cast<std::ptrdiff_t>(end_ - begin)) {}
+
+        bool claim(Index &first, Index &last) {
+            Index current = next.load(std::memory_order_relaxed);
+            do {
+                if (current >= end) {
+                    return false;
+                }
+                Index chunk = grain;
+                if (schedule == loop_schedule::guided_chunks) {
+                    chunk = std::max<Index>(grain, static_cast<Index>((end - current) / (2 * participants)));
+                }
+                first = current;
+                last = end - current > chunk ? static_cast<Index>(current + chunk) : end;
+            } while (!next.compare_exchange_weak(current, last, std::memory_order_relaxed));
+            return true;
+        }
+
+        // After the first failure the remaining chunks are only counted off.
+        void run(Index first, Index last) {
+            if (!remaining.failed()) {
+                try {
+                    run_range(body, first, last);
+                } catch (...) {
+                    remaining.set_exception(std::current_exception());
+                }
+            }
+            remaining.count_down(static_cast<std::ptrdiff_t>(last - first));
+        }
+
+        void drain() {
+            Index first, last;
+            while (claim(first, last)) {
+                run(first, last);
+            }
+        }
+
+        // static_chunks: slice i is handed to one task up front, but whoever
+        // flips claimed[i] first runs it, so the caller picks up the slice of
+        // a task that was dropped (shutdown(cancel), a full bounded queue).
+        Index slice_begin = 0;
+        Index slice_size = 0;
+        size_t slices = 0;
+        std::unique_ptr<std::atomic<bool>[]> claimed;
+
+        void split(Index begin, size_t count, Index size) {
+            slice_begin = begin;
+            slices = count;
+            slice_size = size;
+            claimed = std::make_unique<std::atomic<bool>[]>(count);
+        }
+
+        void run_slice(size_t i) {
+            if (claimed[i].exchange(true, std::memory_order_relaxed)) {
+                return;
+            }
+            const Index first = static_cast<Index>(slice_begin + static_cast<Index>(i) * slice_size);
+            run(first, end - first > slice_size ? static_cast<Index>(first + slice_size) : end);
+        }
+    };
+
+    // Run items from the front of the range in doubling batches until ~10us
+    // have been measured, then size chunks to ~50us of work. Returns the grain;
+    // begin is advanced past the items already run.
+    template<typename Index, typename F>
+    static Index calibrate_grain(Index &begin, Index end, F &fn) {
+        using namespace std::chrono;
+        const auto start = steady_clock::now();
+        Index measured = 0;
+        nanoseconds elapsed{0};
+        for (Index batch = 1; begin < end && elapsed < microseconds(10); batch *= 2) {
+            const Index last = end - begin > batch ? static_cast<Index>(begin + batch) : end;
+            for (; begin < last; ++begin, ++measured) {
+                fn(begin);
+            }
+            elapsed = steady_clock::now() - start;
+        }
+        const auto per_item = std::max<long long>(1, elapsed.count() / std::max<long long>(1, measured));
+        return static_cast<Index>(std::max<long long>(1, nanoseconds(microseconds(50)).count() / per_item));
     }
 
 public:
-    thread_pool() : done(false), joiner(threads) {
-        unsigned const thread_count = std::thread::hardware_concurrency();
+    thread_pool() : thread_pool(thread_pool_options{}) {}
+
+    explicit thread_pool(const thread_pool_options &options)
+        : done(false), work_stealing(options.work_stealing), idle(options.idle), aging_limit(options.aging_limit),
+          min_threads(std::max(1u, options.min_threads ? options.min_threads : options.thread_count)),
+          max_threads(std::max(min_threads, options.max_threads ? options.max_threads : options.thread_count)),
+          idle_timeout(options.idle_timeout), grow_interval(options.grow_interval),
+          affinity_steal_delay(options.affinity_steal_delay), joiner(threads) {
+        unsigned const thread_count = std::clamp(options.thread_count, min_threads, max_threads);
+        const bool pin = options.pin_threads || options.numa_aware;
+        std::vector<cpu_info> cpus;
+        unsigned nodes = 1;
+        if (pin) {
+            cpu_topology topology;
+            if (options.topology) {
+                topology = *options.topology;
+            } else {
+                topology = cpu_topology::read();
+                topology.restrict_to_allowed_cpus();
+            }
+            cpus = topology.placement_order();
+            if (options.numa_aware) {
+                nodes = topology.node_count;
+                for (const auto &info: topology.cpus) {
+                    if (info.cpu >= cpu_node.size()) {
+                        cpu_node.resize(info.cpu + 1, 0);
+                    }
+                    cpu_node[info.cpu] = info.node;
+                }
+            }
+        }
+        node_lanes = std::vector<lane_set>(nodes);
+        if (options.queue_capacity != 0) {
+            bound = std::make_unique<queue_bound>(options.queue_capacity, options.overflow);
+            for (auto &lanes: node_lanes) {
+                for (auto &l: lanes) {
+                    l.bound = bound.get();
+                }
+            }
+        }
+        placements.resize(max_threads);
+        for (unsigned i = 0; i < max_threads; ++i) {
+            placements[i].worker = i;
+            if (!cpus.empty()) {
+                const cpu_info &info = cpus[i % cpus.size()];
+                placements[i].cpu = static_cast<int>(info.cpu);
+                placements[i].node = options.numa_aware ? info.node : 0;
+            }
+        }
         try {
+            if (work_stealing) {
+                for (unsigned i = 0; i < max_threads; ++i) {
+                    queues.push_back(std::make_unique<local_queue_type>());
+                }
+            }
+            slot_active = std::make_unique<std::atomic<bool>[]>(max_threads);
+            inboxes = std::make_unique<worker_inbox[]>(max_threads);
+            for (unsigned i = 0; i < max_threads; ++i) {
+                inboxes[i].bound = bound.get();
+            }
+            parked = std::make_unique<std::atomic<bool>[]>(max_threads);
+#if THREAD_POOL_ENABLE_STATS
+            counters = std::make_unique<worker_counters[]>(max_threads);
+#endif
+#if THREAD_POOL_ENABLE_TRACING
+            for (unsigned i = 0; i < max_threads; ++i) {
+                rings.push_back(std::make_unique<trace_ring>(options.trace_events_per_worker));
+            }
+#endif
+            threads.resize(max_threads);
             for (unsigned i = 0; i < thread_count; ++i) {
-                threads.emplace_back(&thread_pool::work_thread, this);
+                live_workers.fetch_add(1, std::memory_order_relaxed);
+                start_worker(i);
+            }
+#if THREAD_POOL_ENABLE_STATS
+            if (options.stats_interval.count() > 0) {
+                stats_reporter = std::thread(&thread_pool::report_stats, this, options.stats_interval);
             }
+#endif
         } catch (...) {
+            // Workers already started may be parked; wake them so the joiner
+            // can join them and the exception gets out.
             done = true;
+            work_available.notify_all();
             throw;
         }
     }
 
-    ~thread_pool() {
+    // Drains the queue first; use shutdown(shutdown_mode::cancel) beforehand
+    // to drop it instead.
+    ~thread_pool() { shutdown(shutdown_mode::drain); }
+
+    // Stop the pool and join its workers; see shutdown_mode. Later submissions
+    // complete their futures with task_cancelled right away. Calling it again
+    // does nothing. Must not be called from one of the pool's own workers.
+    void shutdown(shutdown_mode mode = shutdown_mode::drain) {
+        if (current_pool == this) {
+            throw std::logic_error("thread_pool::shutdown called from one of its own workers");
+        }
+        std::lock_guard lock(shutdown_mutex);
+        if (shut_down) {
+            return;
+        }
+        if (mode == shutdown_mode::cancel) {
+            cancelling = true;
+            stopper.request_stop();
+        }
+        // Timers due later are dropped in either mode; marking the once_flag
+        // keeps a late schedule_after from starting the timer thread.
+        std::call_once(timers_started, [] {});
+        if (timers) {
+            // Fires already queued are run or discarded with the other tasks
+            // below; timers->stop() then finds none left.
+            timers->request_stop();
+        }
         done = true;
+        work_available.notify_all();
+        if (bound) {
+            bound->room.notify_all();
+        }
+#if THREAD_POOL_ENABLE_STATS
+        {
+            std::lock_guard stats_lock(stats_mutex);
+        }
+        stats_stop.notify_all();
+        if (stats_reporter.joinable()) {
+            stats_reporter.join();
+        }
+#endif
+        {
+            // No worker can be started once done is set and this is released.
+            std::lock_guard grow_lock(grow_mutex);
+        }
+        for (auto &t: threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+        // Whatever is left was cancelled, or raced with the shutdown.
+        function_wapper task;
+        while (try_pop_task(task)) {
+            discard(std::move(task));
+        }
+        if (timers) {
+            timers->stop();
+        }
+        live_workers = 0;
+        shut_down = true;
+    }
+
+    // Run fn on the pool once delay has passed. The returned id can be passed
+    // to cancel_timer. Timers still pending at shutdown never run.
+    template<typename F>
+    timer_id schedule_after(std::chrono::steady_clock::duration delay, F &&fn) {
+        timer_service<internal_executor> *const t = timer();
+        return t ? t->schedule_after(delay, std::forward<F>(fn)) : timer_id{};
+    }
+
+    // Run fn on the pool every period, first after one period. A run that is
+    // late does not overlap the previous one; the next is due right away.
+    template<typename F>
+    timer_id schedule_every(std::chrono::steady_clock::duration period, F &&fn) {
+        timer_service<internal_executor> *const t = timer();
+        return t ? t->schedule_every(period, std::forward<F>(fn)) : timer_id{};
     }
 
+    // True if a future run was prevented.
+    bool cancel_timer(timer_id id) { return id.valid() && timer()->cancel(id); }
+
+    // Requested by shutdown(cancel). Long tasks poll it to give their worker
+    // back early.
+    stop_token get_stop_token() const { return stopper.get_token(); }
+
     template<typename F, typename ...Args>
-    auto submit(F &&f, Args &&...args) -> std::future<decltype(f(args...))> {
-        using result_type = decltype(f(args...));
-        std::function<result_type()> func = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
-        std::packaged_task<result_type()> task(std::move(func));
-        std::future<result_type> res(task.get_future());
-        work_queue.push(function_wapper(std::move(task)));
-        // work_queue.push(std::move(task));
+    auto submit(F &&f, Args &&...args)
+        -> task_future<std::invoke_result_t<std::decay_t<F> &, std::decay_t<Args> &...>> {
+        return submit(task_priority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template<typename F, typename ...Args>
+    auto submit(task_priority priority, F &&f, Args &&...args)
+        -> task_future<std::invoke_result_t<std::decay_t<F> &, std::decay_t<Args> &...>> {
+        using result_type = std::invoke_result_t<std::decay_t<F> &, std::decay_t<Args> &...>;
+        task_promise<result_type> promise;
+        task_future<result_type> res(promise.get_future());
+        push_task(make_task(std::move(promise), std::forward<F>(f), std::forward<Args>(args)...), priority);
         return res;
     }
 
-    void run_pending_task() {
-        function_wapper task;
-        // std::function<void()> task;
-        if (work_queue.try_pop(task)) {
-            task();
+    // Fire-and-forget: no future, and the callable is stored inline when small.
+    template<typename F>
+    void execute(F &&f, task_priority priority = task_priority::normal) {
+        push_task(function_wapper(std::forward<F>(f)), priority);
+    }
+
+    // Like submit, but never waits for room: empty when a bounded queue is
+    // full or the pool is shutting down, whatever the overflow policy.
+    template<typename F, typename ...Args>
+    auto try_submit(F &&f, Args &&...args)
+        -> std::optional<task_future<std::invoke_result_t<std::decay_t<F> &, std::decay_t<Args> &...>>> {
+        using result_type = std::invoke_result_t<std::decay_t<F> &, std::decay_t<Args> &...>;
+        if (!try_reserve()) {
+            return std::nullopt;
+        }
+        task_promise<result_type> promise;
+        task_future<result_type> res(promise.get_future());
+        push_task(make_task(std::move(promise), std::forward<F>(f), std::forward<Args>(args)...),
+                  task_priority::normal, admission::reserved);
+        return res;
+    }
+
+    // Run on worker slot `worker` (0 .. max_threads-1), ahead of the shared
+    // queue there, e.g. next to data an earlier task left in that core's
+    // cache. Other workers take it only after affinity_steal_delay. A slot
+    // with no live worker gets an ordinary submission instead.
+    template<typename F, typename ...Args>
+    auto submit_on(unsigned worker, F &&f, Args &&...args)
+        -> task_future<std::invoke_result_t<std::decay_t<F> &, std::decay_t<Args> &...>> {
+        using result_type = std::invoke_result_t<std::decay_t<F> &, std::decay_t<Args> &...>;
+        if (worker >= max_threads) {
+            throw std::out_of_range("thread_pool::submit_on: no such worker");
+        }
+        task_promise<result_type> promise;
+        task_future<result_type> res(promise.get_future());
+        push_task_to(worker, make_task(std::move(promise), std::forward<F>(f), std::forward<Args>(args)...));
+        return res;
+    }
+
+    // submit_on the calling worker; a plain submit from other threads.
+    template<typename F, typename ...Args>
+    auto submit_local(F &&f, Args &&...args)
+        -> task_future<std::invoke_result_t<std::decay_t<F> &, std::decay_t<Args> &...>> {
+        if (current_pool != this) {
+            return submit(std::forward<F>(f), std::forward<Args>(args)...);
+        }
+        return submit_on(my_index, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    // Slot of the calling worker, for submit_on; -1 on other threads.
+    int worker_index() const { return current_pool == this ? static_cast<int>(my_index) : -1; }
+
+    // Like execute, but false instead of waiting for room; f is then left
+    // untouched.
+    template<typename F>
+    bool try_execute(F &&f, task_priority priority = task_priority::normal) {
+        if (!try_reserve()) {
+            return false;
+        }
+        push_task(function_wapper(std::forward<F>(f)), priority, admission::reserved);
+        return true;
+    }
+
+#if CPP_CONCURRENCY_HAS_COROUTINES
+    struct schedule_awaiter {
+        thread_pool &pool;
+        std::exception_ptr error;
+
+        // Resumes the coroutine on a worker. If the pool drops the task
+        // instead (a full bounded queue, shutdown(cancel)), its destructor
+        // resumes the coroutine right there with the error, which co_await
+        // then throws, so the coroutine is never left suspended for good.
+        class resume_task {
+        private:
+            std::coroutine_handle<> handle;
+            schedule_awaiter *awaiter;
+
+        public:
+            resume_task(std::coroutine_handle<> handle_, schedule_awaiter *awaiter_)
+                : handle(handle_), awaiter(awaiter_) {}
+
+            resume_task(resume_task &&other) noexcept
+                : handle(std::exchange(other.handle, nullptr)), awaiter(other.awaiter) {}
+
+            resume_task &operator=(resume_task &&) = delete;
+
+            ~resume_task() {
+                if (handle) {
+                    awaiter->error = cancellation_scope::active() ? cancellation_scope::error()
+                                                                  : std::make_exception_ptr(task_cancelled());
+                    cancellation_scope::outside outside;
+                    std::exchange(handle, nullptr).resume();
+                }
+            }
+
+            void operator()() { std::exchange(handle, nullptr).resume(); }
+        };
+
+        bool await_ready() const noexcept { return false; }
+
+        // The task is two pointers, so it sits inline in the function_wapper.
+        // Nothing here touches the awaiter after push_task: the coroutine may
+        // already be running, or finished, by then.
+        void await_suspend(std::coroutine_handle<> handle) { pool.push_task(function_wapper(resume_task(handle, this))); }
+
+        void await_resume() const {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    };
+
+    // co_await pool.schedule() continues the coroutine on one of the workers;
+    // it throws task_rejected or task_cancelled if the pool drops it instead.
+    schedule_awaiter schedule() { return schedule_awaiter{*this, nullptr}; }
+#endif
+
+    // Enqueue every void() callable in tasks with one queue operation. The
+    // returned latch opens when all of them have run; wait() rethrows the
+    // first exception.
+    template<typename Range>
+    std::shared_ptr<countdown_latch> bulk_submit(Range &&tasks) {
+        const auto count = std::distance(std::begin(tasks), std::end(tasks));
+        auto latch = std::make_shared<countdown_latch>(count);
+        auto wrap = [&latch](auto func) {
+            return function_wapper([guard = latch_guard(latch), func = std::move(func)]() mutable {
+                countdown_latch &remaining = guard.disarm();
+                try {
+                    func();
+                } catch (...) {
+                    remaining.set_exception(std::current_exception());
+                }
+                remaining.count_down();
+            });
+        };
+        std::vector<function_wapper> batch;
+        batch.reserve(count);
+        for (auto &task: tasks) {
+            if constexpr (std::is_rvalue_reference_v<Range &&>) {
+                batch.push_back(wrap(std::move(task)));
+            } else {
+                batch.push_back(wrap(task));
+            }
+        }
+        push_tasks(batch);
+        return latch;
+    }
+
+    // Call fn(i) for every i in [begin, end) and return when all calls are
+    // done; the calling thread takes part. grain <= 0 measures the cost of the
+    // first few items and picks a grain from that. Rethrows the first exception.
+    template<typename Index, typename F>
+    void parallel_for(Index begin, Index end, Index grain, F &&fn,
+                      loop_schedule schedule = loop_schedule::dynamic_chunks) {
+        static_assert(std::is_integral_v<Index>, "parallel_for needs an integral index");
+        if (begin >= end) {
+            return;
+        }
+        if (grain <= 0) {
+            grain = calibrate_grain(begin, end, fn);
+            if (begin >= end) {
+                return;
+            }
+        }
+        const auto total = end - begin;
+        const unsigned participants = size() + 1;
+        if (total <= grain) {
+            for (Index i = begin; i < end; ++i) {
+                fn(i);
+            }
+            return;
+        }
+
+        auto loop = std::make_shared<loop_state<Index>>(begin, end, grain, participants, schedule, fn);
+        std::vector<function_wapper> batch;
+        if (schedule == loop_schedule::static_chunks) {
+            const auto chunks = std::min<long long>(participants, (total + grain - 1) / grain);
+            const auto chunk_size = static_cast<Index>((total + chunks - 1) / chunks);
+            loop->split(begin, static_cast<size_t>((total + chunk_size - 1) / chunk_size), chunk_size);
+            for (size_t i = 1; i < loop->slices; ++i) {
+                batch.emplace_back([loop, i] { loop->run_slice(i); });
+            }
+            push_tasks(batch);
+            for (size_t i = 0; i < loop->slices; ++i) {
+                loop->run_slice(i);
+            }
         } else {
+            const auto helpers = std::min<long long>(size(), (total + grain - 1) / grain - 1);
+            for (long long i = 0; i < helpers; ++i) {
+                batch.emplace_back([loop] { loop->drain(); });
+            }
+            push_tasks(batch);
+            loop->drain();
+        }
+        wait_and_help(loop->remaining);
+    }
+
+    // Run other queued work while the latch is open (see help_until).
+    // Rethrows the latch's first exception.
+    void wait_and_help(countdown_latch &latch) {
+        help_until([&] { return latch.is_ready(); }, [&](std::chrono::nanoseconds t) { latch.wait_for(t); });
+        latch.wait();
+    }
+
+    // Run queued work until the future is ready; the future is not consumed.
+    // This is how a task waits for a child it spawned: the child is usually
+    // still on the waiter's own deque and gets run right here.
+    template<typename T>
+    void wait_and_help(const task_future<T> &future) {
+        help_until([&] { return future.is_ready(); }, [&](std::chrono::nanoseconds t) { future.wait_for(t); });
+    }
+
+    // Marks a worker that is about to block on something the pool cannot see
+    // (I/O, a lock, a future fed from outside). An elastic pool that has no
+    // idle worker starts a compensating one; it retires after idle_timeout
+    // once it is no longer needed. Does nothing on other threads or fixed pools.
+    class blocking_region {
+    public:
+        explicit blocking_region(thread_pool &pool) {
+            if (pool.elastic() && current_pool == &pool) {
+                pool.maybe_grow(true);
+            }
+        }
+
+        blocking_region(const blocking_region &) = delete;
+
+        blocking_region &operator=(const blocking_region &) = delete;
+    };
+
+    void run_pending_task() {
+        if (!try_run_pending_task()) {
             std::this_thread::yield();
         }
     }
+
+    // The pool the calling thread is a worker of, or nullptr.
+    static thread_pool *current() { return current_pool; }
+
+    // Process-wide pool for code that is not handed an executor, created on
+    // first use and shared by the parallel algorithms.
+    static thread_pool &default_pool() {
+        static thread_pool pool;
+        return pool;
+    }
+
+    // Work started from inside a worker stays on that worker's pool, so
+    // nested parallel calls never spin up a second set of threads.
+    static thread_pool &current_or_default() {
+        thread_pool *const pool = current();
+        return pool ? *pool : default_pool();
+    }
+
+    // Live workers; changes over time in an elastic pool.
+    unsigned size() const { return live_workers.load(std::memory_order_relaxed); }
+
+    // Depth and queueing delay of one injection lane, summed over NUMA nodes.
+    // Tasks a worker spawns onto its own deque are not counted here.
+    lane_stats lane_metrics(task_priority priority) const {
+        lane_stats result;
+        for (const auto &lanes: node_lanes) {
+            const lane_stats node = lanes[static_cast<size_t>(priority)].stats();
+            result.depth += node.depth;
+            result.dequeued += node.dequeued;
+            result.total_wait += node.total_wait;
+            result.max_wait = std::max(result.max_wait, node.max_wait);
+        }
+        return result;
+    }
+
+    // Admission counters of a pool with queue_capacity set.
+    backpressure_stats backpressure() const {
+        return bound ? bound->stats() : backpressure_stats{};
+    }
+
+    // Counters of every worker slot. Empty, with enabled == false, unless the
+    // pool is built with THREAD_POOL_ENABLE_STATS.
+    pool_stats stats() const {
+        pool_stats result;
+#if THREAD_POOL_ENABLE_STATS
+        result.enabled = true;
+        for (unsigned i = 0; i < max_threads; ++i) {
+            result.workers.push_back(counters[i].snapshot());
+        }
+#endif
+        return result;
+    }
+
+    // Task timeline as Chrome trace_event JSON, for Perfetto or
+    // chrome://tracing: one track per worker slot, the newest
+    // trace_events_per_worker tasks on each. Safe while the pool runs. An
+    // empty trace unless the pool is built with THREAD_POOL_ENABLE_TRACING.
+    void write_trace(std::ostream &os) const {
+        std::vector<std::vector<trace_event>> workers;
+#if THREAD_POOL_ENABLE_TRACING
+        for (const auto &ring: rings) {
+            workers.push_back(ring->snapshot());
+        }
+        write_chrome_trace(os, workers, trace_epoch.origin(), trace_epoch.ns_per_tick());
+#else
+        write_chrome_trace(os, workers, 0, 1.0);
+#endif
+    }
+
+    bool write_trace(const std::string &path) const {
+        std::ofstream out(path);
+        write_trace(out);
+        return static_cast<bool>(out);
+    }
+
+    // Where each worker runs: the CPU it was pinned to and its NUMA node.
+    std::vector<worker_placement> placement() const {
+        std::lock_guard lock(grow_mutex);
+        std::vector<worker_placement> result;
+        for (unsigned i = 0; i < max_threads; ++i) {
+            if (slot_active[i].load(std::memory_order_acquire)) {
+                result.push_back(placements[i]);
+            }
+        }
+        return result;
+    }
 };
 
 
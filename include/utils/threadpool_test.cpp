@@ -2,10 +2,14 @@
 // Created by csq on 3/12/23.
 //
 #include <iostream>
+#include <array>
 #include <atomic>
 #include <list>
+#include <sstream>
 
 #include "utils/thread_pool.h"
+#include "utils/strand.h"
+#include "utils/task_graph.h"
 #include "algorithm/parallel_accumulate.h"
 #include "algorithm/quicksort.h"
 #include "gtest/gtest.h"
@@ -37,7 +41,7 @@ void increase(int m) {
 TEST(ThreadPoolTest, IncreaseTest) {
     thread_pool pool;
     
-    std::vector<std::future<void>> futures(10);
+    std::vector<task_future<void>> futures(10);
     for (long i = 0; i < 10; ++i) {
         futures[i] = pool.submit(increase, 1000);
     }
@@ -65,5 +69,850 @@ TEST(ThreadPoolTest, QuicksortTest) {
     std::reverse(nums.begin(), nums.end());
 
     auto ret = parallel_quick_sort<int>(nums);
-    EXPECT_EQ(ret, nums);
-}
\ No newline at end of file
+    EXPECT_EQ(ret, nums_org);
+}
+
+TEST(ThreadPoolTest, SharedQueueModeTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    options.work_stealing = false;
+    thread_pool pool(options);
+
+    std::vector<task_future<int>> futures;
+    for (int i = 0; i < 100; ++i) {
+        futures.push_back(pool.submit([i] { return i; }));
+    }
+    int sum = 0;
+    for (auto &f: futures) {
+        sum += f.get();
+    }
+    EXPECT_EQ(sum, 4950);
+}
+
+TEST(ThreadPoolTest, NestedSubmitTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+
+    std::atomic<int> count{0};
+    auto outer = pool.submit([&] {
+        std::vector<task_future<void>> inner;
+        for (int i = 0; i < 100; ++i) {
+            inner.push_back(pool.submit([&] { count.fetch_add(1, std::memory_order_relaxed); }));
+        }
+        for (auto &f: inner) {
+            while (f.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) {
+                pool.run_pending_task();
+            }
+        }
+    });
+    outer.get();
+    EXPECT_EQ(count, 100);
+}
+
+TEST(ThreadPoolTest, ParkedWorkersWakeTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    options.idle = idle_policy::low_power();
+    thread_pool pool(options);
+
+    for (int round = 0; round < 20; ++round) {
+        // Long enough for every worker to reach the parked state.
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        std::vector<task_future<int>> futures;
+        for (int i = 0; i < 8; ++i) {
+            futures.push_back(pool.submit([i] { return i; }));
+        }
+        int sum = 0;
+        for (auto &f: futures) {
+            sum += f.get();
+        }
+        EXPECT_EQ(sum, 28);
+    }
+}
+
+TEST(ThreadPoolTest, FunctionWapperTest) {
+    static_assert(sizeof(function_wapper) == 64);
+
+    int calls = 0;
+    auto counter = std::make_shared<int>(0);
+    std::array<int, 64> big{};
+    big[63] = 5;
+
+    // Small move-only callable (inline) and large one (heap), moved around.
+    function_wapper small([&calls, p = std::make_unique<int>(2)] { calls += *p; });
+    function_wapper large([&calls, big, counter] { calls += big[63]; });
+    EXPECT_EQ(counter.use_count(), 2);
+
+    function_wapper moved(std::move(small));
+    EXPECT_FALSE(small);
+    moved();
+    EXPECT_EQ(calls, 2);
+
+    moved = std::move(large);
+    moved();
+    EXPECT_EQ(calls, 7);
+    moved = function_wapper();
+    EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(ThreadPoolTest, TaskFutureTest) {
+    thread_pool pool;
+
+    auto value = pool.submit([] { return std::string("value"); });
+    EXPECT_EQ(value.get(), "value");
+    EXPECT_FALSE(value.valid());
+
+    auto error = pool.submit([]() -> int { throw std::runtime_error("task failed"); });
+    EXPECT_THROW(error.get(), std::runtime_error);
+
+    std::atomic<bool> release{false};
+    auto slow = pool.submit([&] {
+        while (!release) {
+            std::this_thread::yield();
+        }
+        return 1;
+    });
+    EXPECT_EQ(slow.wait_for(std::chrono::milliseconds(1)), std::future_status::timeout);
+    EXPECT_FALSE(slow.is_ready());
+    release = true;
+    slow.wait();
+    EXPECT_TRUE(slow.is_ready());
+    EXPECT_EQ(slow.get(), 1);
+
+    task_future<int> broken;
+    {
+        task_promise<int> promise;
+        broken = promise.get_future();
+    }
+    EXPECT_THROW(broken.get(), std::future_error);
+}
+
+TEST(ThreadPoolTest, ParallelForTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+
+    const int size = 100000;
+    for (auto schedule: {loop_schedule::static_chunks, loop_schedule::dynamic_chunks,
+                         loop_schedule::guided_chunks}) {
+        for (int grain: {0, 1, 64, 2 * size}) {
+            std::vector<std::atomic<int>> visits(size);
+            pool.parallel_for(0, size, grain, [&](int i) { visits[i].fetch_add(1, std::memory_order_relaxed); },
+                              schedule);
+            EXPECT_TRUE(std::all_of(visits.begin(), visits.end(), [](auto &v) { return v.load() == 1; }));
+        }
+    }
+
+    EXPECT_THROW(pool.parallel_for(0L, 1000L, 10L, [](long i) {
+        if (i == 500) {
+            throw std::runtime_error("item failed");
+        }
+    }), std::runtime_error);
+}
+
+TEST(ThreadPoolTest, BulkSubmitTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+
+    std::atomic<int> sum{0};
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < 1000; ++i) {
+        tasks.emplace_back([&sum, i] { sum.fetch_add(i, std::memory_order_relaxed); });
+    }
+    auto done = pool.bulk_submit(std::move(tasks));
+    done->wait();
+    EXPECT_EQ(sum, 499500);
+
+    std::vector<std::function<void()>> failing{[] {}, [] { throw std::logic_error("bad"); }, [] {}};
+    EXPECT_THROW(pool.bulk_submit(failing)->wait(), std::logic_error);
+}
+
+TEST(ThreadPoolTest, PriorityLaneTest) {
+    thread_pool_options options;
+    options.thread_count = 1;
+    options.aging_limit = 1000;
+    thread_pool pool(options);
+
+    // Hold the only worker so every lane fills up before anything runs.
+    std::atomic<bool> release{false};
+    auto gate = pool.submit([&] {
+        while (!release) {
+            std::this_thread::yield();
+        }
+    });
+    while (pool.lane_metrics(task_priority::normal).depth != 0) {
+        std::this_thread::yield();
+    }
+
+    std::mutex m;
+    std::vector<char> order;
+    auto record = [&](char c) {
+        std::lock_guard lk(m);
+        order.push_back(c);
+    };
+    std::vector<task_future<void>> futures;
+    for (int i = 0; i < 3; ++i) {
+        futures.push_back(pool.submit(task_priority::low, record, 'l'));
+        futures.push_back(pool.submit(record, 'n'));
+        futures.push_back(pool.submit(task_priority::high, record, 'h'));
+    }
+    EXPECT_EQ(pool.lane_metrics(task_priority::low).depth, 3);
+    release = true;
+    for (auto &f: futures) {
+        f.get();
+    }
+    EXPECT_EQ(std::string(order.begin(), order.end()), "hhhnnnlll");
+    EXPECT_EQ(pool.lane_metrics(task_priority::high).dequeued, 3);
+    EXPECT_GT(pool.lane_metrics(task_priority::low).max_wait.count(), 0);
+}
+
+TEST(ThreadPoolTest, PriorityAgingTest) {
+    thread_pool_options options;
+    options.thread_count = 1;
+    options.aging_limit = 2;
+    thread_pool pool(options);
+
+    std::atomic<bool> release{false};
+    auto gate = pool.submit([&] {
+        while (!release) {
+            std::this_thread::yield();
+        }
+    });
+    while (pool.lane_metrics(task_priority::normal).depth != 0) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<int> high_done{0};
+    std::atomic<int> high_done_before_low{-1};
+    std::vector<task_future<void>> futures;
+    futures.push_back(pool.submit(task_priority::low, [&] { high_done_before_low = high_done.load(); }));
+    for (int i = 0; i < 20; ++i) {
+        futures.push_back(pool.submit(task_priority::high, [&] { ++high_done; }));
+    }
+    release = true;
+    for (auto &f: futures) {
+        f.get();
+    }
+    EXPECT_LE(high_done_before_low, 2);
+}
+
+TEST(ThreadPoolTest, ContinuationTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+
+    auto chained = pool.submit([] { return 20; })
+        .then(pool, [](int v) { return v + 1; })
+        .then(pool, [](int v) { return std::to_string(v * 2); });
+    EXPECT_EQ(chained.get(), "42");
+
+    auto failed = pool.submit([]() -> int { throw std::runtime_error("first stage"); })
+        .then(pool, [](int v) { return v + 1; });
+    EXPECT_THROW(failed.get(), std::runtime_error);
+
+    std::vector<task_future<int>> inputs;
+    for (int i = 0; i < 10; ++i) {
+        inputs.push_back(pool.submit([i] { return i * i; }));
+    }
+    auto all = when_all(std::move(inputs)).then(pool, [](std::vector<int> values) {
+        return std::accumulate(values.begin(), values.end(), 0);
+    });
+    EXPECT_EQ(all.get(), 285);
+
+    std::atomic<bool> release{false};
+    std::vector<task_future<int>> racers;
+    racers.push_back(pool.submit([&] {
+        while (!release) {
+            std::this_thread::yield();
+        }
+        return 0;
+    }));
+    racers.push_back(pool.submit([] { return 1; }));
+    auto any = when_any(std::move(racers)).get();
+    EXPECT_EQ(any.index, 1);
+    EXPECT_EQ(any.futures[1].get(), 1);
+    release = true;
+    EXPECT_EQ(any.futures[0].get(), 0);
+}
+
+TEST(ThreadPoolTest, AccumulateAsyncTest) {
+    thread_pool pool;
+    std::vector<int> nums(10000);
+    std::iota(nums.begin(), nums.end(), 0);
+
+    auto sum = parallel_accumulate_async(pool, nums.begin(), nums.end(), 5);
+    EXPECT_EQ(sum.get(), 49995005);
+    EXPECT_EQ(parallel_accumulate_async(pool, nums.begin(), nums.begin(), 7).get(), 7);
+}
+
+TEST(ThreadPoolTest, NumaPlacementTest) {
+    // A made-up two-node machine; pinning to CPUs that do not exist here just
+    // fails, the node-local lanes and stealing still apply.
+    cpu_topology topology;
+    for (unsigned cpu = 0; cpu < 4; ++cpu) {
+        cpu_info info;
+        info.cpu = cpu;
+        info.core = cpu;
+        info.node = cpu / 2;
+        topology.cpus.push_back(info);
+    }
+    topology.node_count = 2;
+
+    thread_pool_options options;
+    options.thread_count = 4;
+    options.numa_aware = true;
+    options.topology = topology;
+    thread_pool pool(options);
+
+    auto placement = pool.placement();
+    ASSERT_EQ(placement.size(), 4u);
+    for (unsigned i = 0; i < 4; ++i) {
+        EXPECT_EQ(placement[i].worker, i);
+        EXPECT_EQ(placement[i].cpu, static_cast<int>(i));
+        EXPECT_EQ(placement[i].node, i / 2);
+    }
+
+    std::atomic<int> count{0};
+    std::vector<task_future<void>> futures;
+    for (int i = 0; i < 1000; ++i) {
+        futures.push_back(pool.submit(i % 3 == 0 ? task_priority::low : task_priority::normal, [&count] {
+            ++count;
+        }));
+    }
+    for (auto &f: futures) {
+        f.get();
+    }
+    EXPECT_EQ(count, 1000);
+    EXPECT_EQ(pool.lane_metrics(task_priority::normal).dequeued + pool.lane_metrics(task_priority::low).dequeued,
+              1000u);
+
+    thread_pool plain;
+    EXPECT_EQ(plain.placement().front().cpu, -1);
+}
+
+TEST(ThreadPoolTest, ElasticPoolTest) {
+    thread_pool_options options;
+    options.thread_count = 1;
+    options.min_threads = 1;
+    options.max_threads = 4;
+    options.idle_timeout = std::chrono::milliseconds(20);
+    options.grow_interval = std::chrono::microseconds(0);
+    thread_pool pool(options);
+    EXPECT_EQ(pool.size(), 1u);
+
+    // Four tasks that only finish together: a fixed single-worker pool would
+    // deadlock, the blocking hint brings in the workers they need.
+    std::atomic<int> arrived{0};
+    std::vector<task_future<void>> futures;
+    for (int i = 0; i < 4; ++i) {
+        futures.push_back(pool.submit([&] {
+            ++arrived;
+            thread_pool::blocking_region region(pool);
+            while (arrived < 4) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }));
+    }
+    for (auto &f: futures) {
+        f.get();
+    }
+    EXPECT_GT(pool.size(), 1u);
+    EXPECT_LE(pool.size(), 4u);
+
+    // Extra workers retire once they have been idle for idle_timeout.
+    for (int i = 0; i < 200 && pool.size() > 1; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(pool.size(), 1u);
+    EXPECT_EQ(pool.placement().size(), 1u);
+    EXPECT_EQ(pool.submit([] { return 7; }).get(), 7);
+}
+
+TEST(ThreadPoolTest, DefaultPoolTest) {
+    thread_pool &pool = thread_pool::default_pool();
+    EXPECT_EQ(&pool, &thread_pool::default_pool());
+    EXPECT_EQ(thread_pool::current(), nullptr);
+    EXPECT_EQ(&thread_pool::current_or_default(), &pool);
+
+    std::vector<int> nums(1000);
+    std::iota(nums.begin(), nums.end(), 1);
+    EXPECT_EQ(parallel_accumulate(nums.begin(), nums.end(), 0), 500500);
+
+    // Nested calls from a worker stay on that worker's pool, even with a
+    // single worker.
+    thread_pool_options options;
+    options.thread_count = 1;
+    thread_pool single(options);
+    auto nested = single.submit([&] {
+        EXPECT_EQ(&thread_pool::current_or_default(), &single);
+        std::list<int> values(nums.rbegin(), nums.rend());
+        auto sorted = parallel_quick_sort(values);
+        return parallel_accumulate(nums.begin(), nums.end(), 0) + (std::is_sorted(sorted.begin(), sorted.end()) ? 0 : 1);
+    });
+    EXPECT_EQ(nested.get(), 500500);
+}
+
+TEST(ThreadPoolTest, StatsDisabledTest) {
+    thread_pool pool;
+    pool.submit([] {}).get();
+    pool_stats stats = pool.stats();
+    EXPECT_FALSE(stats.enabled);
+    EXPECT_TRUE(stats.workers.empty());
+}
+
+TEST(ThreadPoolTest, TracingDisabledTest) {
+    thread_pool pool;
+    pool.submit([] {}).get();
+    std::ostringstream out;
+    pool.write_trace(out);
+    EXPECT_EQ(out.str(), "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[]}\n");
+}
+
+TEST(ThreadPoolTest, StopTokenTest) {
+    stop_token never;
+    EXPECT_FALSE(never.stop_possible());
+    EXPECT_FALSE(never.stop_requested());
+
+    stop_source source;
+    stop_token token = source.get_token();
+    EXPECT_TRUE(token.stop_possible());
+    EXPECT_FALSE(token.stop_requested());
+    EXPECT_TRUE(source.request_stop());
+    EXPECT_FALSE(source.request_stop());
+    EXPECT_TRUE(token.stop_requested());
+}
+
+TEST(ThreadPoolTest, ShutdownDrainTest) {
+    thread_pool_options options;
+    options.thread_count = 2;
+    thread_pool pool(options);
+    std::atomic<int> count{0};
+    for (int i = 0; i < 100; ++i) {
+        pool.execute([&] {
+            // Children spawned while draining still run.
+            pool.execute([&] { ++count; });
+            ++count;
+        });
+    }
+    pool.shutdown(shutdown_mode::drain);
+    EXPECT_EQ(count, 200);
+    EXPECT_EQ(pool.size(), 0u);
+
+    auto late = pool.submit([] { return 1; });
+    EXPECT_THROW(late.get(), task_cancelled);
+    pool.shutdown();
+}
+
+TEST(ThreadPoolTest, ShutdownCancelTest) {
+    thread_pool_options options;
+    options.thread_count = 1;
+    thread_pool pool(options);
+
+    std::atomic<bool> started{false};
+    auto runaway = pool.submit([&, token = pool.get_stop_token()] {
+        started = true;
+        long spins = 0;
+        while (!token.stop_requested()) {
+            ++spins;
+            std::this_thread::yield();
+        }
+        return spins;
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+    std::vector<task_future<int>> queued;
+    for (int i = 0; i < 10; ++i) {
+        queued.push_back(pool.submit([i] { return i; }));
+    }
+    auto batch = pool.bulk_submit(std::vector<std::function<void()>>(3, [] {}));
+    task_graph graph;
+    graph.add_node([] {});
+
+    const auto start = std::chrono::steady_clock::now();
+    pool.shutdown(shutdown_mode::cancel);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+
+    EXPECT_GE(runaway.get(), 0);
+    for (auto &f: queued) {
+        EXPECT_THROW(f.get(), task_cancelled);
+    }
+    EXPECT_THROW(batch->wait(), task_cancelled);
+    EXPECT_THROW(graph.run(pool), task_cancelled);
+}
+
+// Successors released during shutdown(cancel) are discarded; run() still
+// waits for the sibling node that is running on the other worker. run()
+// helps too and usually takes the first root, a decoy; returns whether the
+// two roots under test both ran on workers.
+static bool check_cancelled_graph() {
+    thread_pool_options options;
+    options.thread_count = 2;
+    thread_pool pool(options);
+    const stop_token token = pool.get_stop_token();
+
+    task_graph graph;
+    std::atomic<int> started{0};
+    std::atomic<int> on_workers{0};
+    std::atomic<bool> slow_done{false};
+    auto root = [&] {
+        ++started;
+        while (!token.stop_requested()) {
+            std::this_thread::yield();
+        }
+    };
+    graph.add_node(root);
+    graph.add_node([&] {
+        on_workers += pool.worker_index() >= 0;
+        root();
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        slow_done = true;
+    });
+    auto fast = graph.add_node([&] {
+        on_workers += pool.worker_index() >= 0;
+        root();
+        // Past the point where shutdown refuses new tasks.
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    });
+    graph.add_edge(fast, graph.add_node([] {}));
+    graph.add_edge(fast, graph.add_node([] {}));
+
+    std::atomic<bool> finished_early{false};
+    std::thread runner([&] {
+        EXPECT_THROW(graph.run(pool), task_cancelled);
+        finished_early = !slow_done;
+    });
+    while (started < 3) {
+        std::this_thread::yield();
+    }
+    pool.shutdown(shutdown_mode::cancel);
+    runner.join();
+    EXPECT_FALSE(finished_early.load());
+    return on_workers == 2;
+}
+
+TEST(ThreadPoolTest, ShutdownCancelGraphTest) {
+    bool exercised = false;
+    for (int attempt = 0; attempt < 50 && !exercised; ++attempt) {
+        exercised = check_cancelled_graph();
+    }
+    EXPECT_TRUE(exercised);
+}
+
+TEST(ThreadPoolTest, TimerTest) {
+    thread_pool_options options;
+    options.thread_count = 2;
+    thread_pool pool(options);
+
+    std::atomic<int> once{0};
+    std::atomic<int> ticks{0};
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<long long> fired_after{0};
+    pool.schedule_after(std::chrono::milliseconds(10), [&] {
+        fired_after = (std::chrono::steady_clock::now() - start).count();
+        ++once;
+    });
+    timer_id cancelled = pool.schedule_after(std::chrono::milliseconds(5), [&] { ++once; });
+    EXPECT_TRUE(pool.cancel_timer(cancelled));
+    timer_id periodic = pool.schedule_every(std::chrono::milliseconds(1), [&] { ++ticks; });
+
+    while (once == 0 || ticks < 5) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(pool.cancel_timer(periodic));
+    EXPECT_GE(fired_after, std::chrono::nanoseconds(std::chrono::milliseconds(10)).count());
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(once, 1);
+
+    // Pending timers are dropped at shutdown, and later ones are refused.
+    pool.schedule_after(std::chrono::hours(1), [&] { ++once; });
+    pool.shutdown();
+    EXPECT_FALSE(pool.schedule_after(std::chrono::milliseconds(1), [] {}).valid());
+    EXPECT_EQ(once, 1);
+}
+
+namespace {
+
+long fib(thread_pool &pool, int n) {
+    if (n < 12) {
+        return n < 2 ? n : fib(pool, n - 1) + fib(pool, n - 2);
+    }
+    auto left = pool.submit([&pool, n] { return fib(pool, n - 1); });
+    const long right = fib(pool, n - 2);
+    pool.wait_and_help(left);
+    return left.get() + right;
+}
+
+}
+
+TEST(ThreadPoolTest, WaitAndHelpTest) {
+    thread_pool_options options;
+    options.thread_count = 1;
+    thread_pool pool(options);
+
+    // Recursive divide and conquer on a single worker.
+    EXPECT_EQ(pool.submit([&pool] { return fib(pool, 24); }).get(), 46368);
+
+    // The awaited task is submitted only after the worker started waiting:
+    // the waiter has to notice new work while it sleeps.
+    task_promise<task_future<int>> handoff;
+    auto later = handoff.get_future();
+    auto waiter = pool.submit([&pool, &later] {
+        task_future<int> inner = later.get();
+        pool.wait_and_help(inner);
+        return inner.get() + 1;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    handoff.set_value(pool.submit([] { return 41; }));
+    EXPECT_EQ(waiter.get(), 42);
+}
+
+// One worker held on a gate, so submissions from here stay in the lanes.
+struct gated_pool {
+    std::atomic<bool> started{false};
+    std::atomic<bool> open{false};
+    thread_pool pool;
+
+    gated_pool(size_t capacity, overflow_policy overflow) : pool([&] {
+        thread_pool_options options;
+        options.thread_count = 1;
+        options.queue_capacity = capacity;
+        options.overflow = overflow;
+        return options;
+    }()) {
+        pool.execute([this] {
+            started = true;
+            while (!open) {
+                std::this_thread::yield();
+            }
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+    }
+
+    ~gated_pool() { open = true; }
+};
+
+TEST(ThreadPoolTest, BackpressureRejectTest) {
+    gated_pool g(4, overflow_policy::reject);
+    std::vector<task_future<int>> accepted;
+    for (int i = 0; i < 4; ++i) {
+        accepted.push_back(g.pool.submit([i] { return i; }));
+    }
+    auto refused = g.pool.submit([] { return -1; });
+    EXPECT_THROW(refused.get(), task_rejected);
+    EXPECT_FALSE(g.pool.try_submit([] { return -1; }).has_value());
+    bool ran = false;
+    EXPECT_FALSE(g.pool.try_execute([&ran] { ran = true; }));
+
+    backpressure_stats stats = g.pool.backpressure();
+    EXPECT_EQ(stats.capacity, 4u);
+    EXPECT_EQ(stats.queued, 4u);
+    EXPECT_EQ(stats.rejected, 3u);
+
+    g.open = true;
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(accepted[i].get(), i);
+    }
+    EXPECT_FALSE(ran);
+    auto later = g.pool.try_submit([] { return 7; });
+    ASSERT_TRUE(later.has_value());
+    EXPECT_EQ(later->get(), 7);
+}
+
+TEST(ThreadPoolTest, BackpressureCallerRunsTest) {
+    gated_pool g(2, overflow_policy::caller_runs);
+    auto a = g.pool.submit([] { return std::this_thread::get_id(); });
+    auto b = g.pool.submit([] { return std::this_thread::get_id(); });
+    auto c = g.pool.submit([] { return std::this_thread::get_id(); });
+    EXPECT_EQ(c.get(), std::this_thread::get_id());
+    EXPECT_EQ(g.pool.backpressure().ran_on_caller, 1u);
+    g.open = true;
+    EXPECT_NE(a.get(), std::this_thread::get_id());
+    EXPECT_NE(b.get(), std::this_thread::get_id());
+}
+
+TEST(ThreadPoolTest, BackpressureDropOldestTest) {
+    gated_pool g(3, overflow_policy::drop_oldest);
+    std::vector<task_future<int>> futures;
+    for (int i = 0; i < 5; ++i) {
+        futures.push_back(g.pool.submit([i] { return i; }));
+    }
+    EXPECT_EQ(g.pool.backpressure().dropped, 2u);
+    g.open = true;
+    EXPECT_THROW(futures[0].get(), task_rejected);
+    EXPECT_THROW(futures[1].get(), task_rejected);
+    for (int i = 2; i < 5; ++i) {
+        EXPECT_EQ(futures[i].get(), i);
+    }
+}
+
+TEST(ThreadPoolTest, BackpressureBlockTest) {
+    gated_pool g(2, overflow_policy::block);
+    g.pool.execute([] {});
+    g.pool.execute([] {});
+    std::atomic<bool> submitted{false};
+    std::thread producer([&] {
+        g.pool.execute([] {});
+        submitted = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(submitted.load());
+    g.open = true;
+    producer.join();
+    EXPECT_TRUE(submitted.load());
+    backpressure_stats stats = g.pool.backpressure();
+    EXPECT_EQ(stats.blocked, 1u);
+    EXPECT_GE(stats.blocked_time, std::chrono::milliseconds(10));
+}
+
+TEST(ThreadPoolTest, BackpressureWorkersNotBlockedTest) {
+    // Tasks spawned by a worker go past the limit instead of deadlocking it.
+    thread_pool_options options;
+    options.thread_count = 1;
+    options.queue_capacity = 2;
+    options.overflow = overflow_policy::block;
+    thread_pool pool(options);
+    auto total = pool.submit([&pool] {
+        std::vector<task_future<int>> children;
+        for (int i = 0; i < 20; ++i) {
+            children.push_back(pool.submit(task_priority::low, [i] { return i; }));
+        }
+        int sum = 0;
+        for (auto &child: children) {
+            pool.wait_and_help(child);
+            sum += child.get();
+        }
+        return sum;
+    });
+    EXPECT_EQ(total.get(), 190);
+    EXPECT_EQ(pool.backpressure().queued, 0u);
+}
+
+TEST(ThreadPoolTest, BackpressureParallelForTest) {
+    // The slice of a rejected static chunk task is run by the caller.
+    gated_pool g(1, overflow_policy::reject);
+    g.pool.execute([] {});
+    std::vector<std::atomic<int>> visits(1000);
+    g.pool.parallel_for(0, 1000, 100, [&](int i) { visits[i].fetch_add(1, std::memory_order_relaxed); },
+                        loop_schedule::static_chunks);
+    EXPECT_TRUE(std::all_of(visits.begin(), visits.end(), [](auto &v) { return v.load() == 1; }));
+    EXPECT_GE(g.pool.backpressure().rejected, 1u);
+}
+
+TEST(ThreadPoolTest, BackpressureSubmitOnTest) {
+    // Tasks sent to one worker count against the capacity too.
+    gated_pool g(2, overflow_policy::reject);
+    auto a = g.pool.submit_on(0, [] { return 1; });
+    auto b = g.pool.submit_on(0, [] { return 2; });
+    auto refused = g.pool.submit_on(0, [] { return 3; });
+    EXPECT_THROW(refused.get(), task_rejected);
+    EXPECT_EQ(g.pool.backpressure().queued, 2u);
+    g.open = true;
+    EXPECT_EQ(a.get(), 1);
+    EXPECT_EQ(b.get(), 2);
+    EXPECT_EQ(g.pool.backpressure().queued, 0u);
+}
+
+// A strand and a periodic timer on a full pool: their own tasks go past the
+// limit, so the policy neither drops them nor runs them on the caller.
+static void check_internal_tasks(overflow_policy overflow) {
+    gated_pool g(1, overflow);
+    g.pool.execute([] {});
+    strand s(g.pool);
+    std::vector<int> order;
+    std::atomic<bool> drained{false};
+    for (int i = 0; i < 3; ++i) {
+        s.post([&order, i] { order.push_back(i); });
+    }
+    s.post([&drained] { drained = true; });
+    std::atomic<int> ticks{0};
+    timer_id id = g.pool.schedule_every(std::chrono::milliseconds(2), [&ticks] { ++ticks; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    if (overflow == overflow_policy::drop_oldest) {
+        // Has to drop the plain task, not the strand or the timer.
+        g.pool.execute([] {});
+    }
+    EXPECT_TRUE(order.empty());
+    EXPECT_EQ(ticks.load(), 0);
+    g.open = true;
+    for (int i = 0; i < 1000 && (!drained || ticks < 3); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(drained.load());
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2}));
+    EXPECT_GE(ticks.load(), 3);
+    EXPECT_TRUE(g.pool.cancel_timer(id));
+}
+
+TEST(ThreadPoolTest, BackpressureInternalTasksTest) {
+    check_internal_tasks(overflow_policy::reject);
+    check_internal_tasks(overflow_policy::drop_oldest);
+    check_internal_tasks(overflow_policy::caller_runs);
+    check_internal_tasks(overflow_policy::block);
+}
+
+TEST(ThreadPoolTest, AffinityTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    // Long enough that nobody else takes the tasks on a loaded machine.
+    options.affinity_steal_delay = std::chrono::seconds(5);
+    thread_pool pool(options);
+
+    EXPECT_EQ(pool.worker_index(), -1);
+    for (int round = 0; round < 10; ++round) {
+        for (unsigned w = 0; w < 4; ++w) {
+            EXPECT_EQ(pool.submit_on(w, [&pool] { return pool.worker_index(); }).get(), static_cast<int>(w));
+        }
+    }
+    auto follow_up = pool.submit_on(2, [&pool] {
+        return pool.submit_local([&pool] { return pool.worker_index(); });
+    });
+    auto inner = follow_up.get();
+    EXPECT_EQ(inner.get(), 2);
+    EXPECT_THROW(pool.submit_on(4, [] {}), std::out_of_range);
+}
+
+TEST(ThreadPoolTest, AffinityStealTest) {
+    thread_pool_options options;
+    options.thread_count = 2;
+    options.affinity_steal_delay = std::chrono::milliseconds(5);
+    thread_pool pool(options);
+
+    std::atomic<bool> started{false};
+    std::atomic<bool> open{false};
+    pool.submit_on(0, [&] {
+        started = true;
+        while (!open) {
+            std::this_thread::yield();
+        }
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+    // Worker 0 is stuck, so worker 1 takes its task once the delay is over.
+    const auto start = std::chrono::steady_clock::now();
+    auto moved = pool.submit_on(0, [&pool] { return pool.worker_index(); });
+    EXPECT_EQ(moved.get(), 1);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(5));
+    open = true;
+}
+
+TEST(ThreadPoolTest, AffinityDrainTest) {
+    std::vector<task_future<int>> futures;
+    {
+        thread_pool_options options;
+        options.thread_count = 2;
+        options.affinity_steal_delay = std::chrono::seconds(60);
+        thread_pool pool(options);
+        for (int i = 0; i < 100; ++i) {
+            futures.push_back(pool.submit_on(i % 2, [i] { return i; }));
+        }
+    }
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(futures[i].get(), i);
+    }
+}
@@ -0,0 +1,374 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_TIMER_SERVICE_H
+#define CPP_CONCURRENCY_TIMER_SERVICE_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "function_wapper.h"
+
+// Names one scheduled timer; a default-constructed id names none.
+struct timer_id {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool valid() const { return index != UINT32_MAX; }
+};
+
+// Delayed and periodic tasks for any executor with execute(F). Pending timers
+// sit in a hierarchical timing wheel: 4 levels of 256 slots with 1ms ticks,
+// so a timer is filed under the level that matches how far away it is and
+// moves down a level each time the level below wraps. Insert and cancel
+// unlink a node from an intrusive list, O(1) under one mutex; nodes live in
+// a deque with a free list and link by 32-bit index, about 100 bytes each.
+//
+// One thread advances the wheel. It sleeps until the next non-empty slot of
+// the lowest level (or that level's wrap), and hands expired timers to the
+// executor; the callables run there, not on the timer thread.
+template<typename Executor>
+class timer_service {
+private:
+    static constexpr unsigned slot_bits = 8;
+    static constexpr unsigned slots = 1u << slot_bits;
+    static constexpr unsigned levels = 4;
+    static constexpr uint32_t nil = UINT32_MAX;
+    static constexpr uint64_t max_delta = (uint64_t(1) << (slot_bits * levels)) - 1;
+
+    enum class node_state : uint8_t { free, armed, running };
+
+    struct timer_node {
+        function_wapper fn;
+        uint64_t expires = 0;
+        // In ticks; 0 for a one-shot timer.
+        uint64_t period = 0;
+        uint32_t prev = nil;
+        uint32_t next = nil;
+        uint32_t generation = 0;
+        uint16_t bucket = 0;
+        node_state state = node_state::free;
+        bool cancelled = false;
+    };
+
+    using clock = std::chrono::steady_clock;
+
+    Executor &executor;
+    const clock::time_point epoch;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    // Stable addresses: a running callable is called in place, outside the lock.
+    std::deque<timer_node> nodes;
+    std::vector<uint32_t> free_nodes;
+    std::array<uint32_t, levels * slots> buckets;
+    uint64_t current = 0;
+    // Tick the timer thread sleeps until; an insert due earlier wakes it.
+    uint64_t sleeping_until = 0;
+    size_t armed = 0;
+    // Fires handed to the executor that have neither run nor been dropped.
+    size_t in_flight = 0;
+    std::condition_variable idle;
+    bool stopping = false;
+    std::thread worker;
+
+    // What the executor holds for one due timer. An executor that destroys
+    // it unrun (a full queue, a cancelling shutdown) still settles the node.
+    class fire_task {
+    private:
+        timer_service *service;
+        timer_id id;
+
+    public:
+        fire_task(timer_service *service_, timer_id id_) : service(service_), id(id_) {}
+
+        fire_task(fire_task &&other) noexcept : service(std::exchange(other.service, nullptr)), id(other.id) {}
+
+        fire_task &operator=(fire_task &&) = delete;
+
+        ~fire_task() {
+            if (service) {
+                service->settle(id);
+            }
+        }
+
+        void operator()() { std::exchange(service, nullptr)->fire(id); }
+    };
+
+    // Deadlines round up and the clock rounds down, so nothing fires early.
+    uint64_t deadline_tick(clock::time_point t) const {
+        return static_cast<uint64_t>(std::chrono::ceil<std::chrono::milliseconds>(t - epoch).count());
+    }
+
+    uint64_t elapsed_ticks() const {
+        return static_cast<uint64_t>(std::chrono::floor<std::chrono::milliseconds>(clock::now() - epoch).count());
+    }
+
+    clock::time_point time_of(uint64_t tick) const { return epoch + std::chrono::milliseconds(tick); }
+
+    void link(uint32_t index) {
+        timer_node &n = nodes[index];
+        // 0 only while cascading into the slot about to be processed.
+        const uint64_t delta = std::min(n.expires > current ? n.expires - current : 0, max_delta);
+        const uint64_t expires = current + delta;
+        unsigned level = 0;
+        while (level + 1 < levels && delta >= (uint64_t(1) << (slot_bits * (level + 1)))) {
+            ++level;
+        }
+        n.bucket = static_cast<uint16_t>(level * slots + ((expires >> (slot_bits * level)) & (slots - 1)));
+        n.prev = nil;
+        n.next = buckets[n.bucket];
+        if (n.next != nil) {
+            nodes[n.next].prev = index;
+        }
+        buckets[n.bucket] = index;
+    }
+
+    void unlink(uint32_t index) {
+        timer_node &n = nodes[index];
+        if (n.prev != nil) {
+            nodes[n.prev].next = n.next;
+        } else {
+            buckets[n.bucket] = n.next;
+        }
+        if (n.next != nil) {
+            nodes[n.next].prev = n.prev;
+        }
+    }
+
+    uint32_t take_bucket(unsigned bucket) {
+        const uint32_t head = buckets[bucket];
+        buckets[bucket] = nil;
+        return head;
+    }
+
+    // Advance one tick; expired timers are appended to due.
+    void tick(std::vector<timer_id> &due) {
+        ++current;
+        for (unsigned level = 1; level < levels; ++level) {
+            if ((current & ((uint64_t(1) << (slot_bits * level)) - 1)) != 0) {
+                break;
+            }
+            const unsigned slot = (current >> (slot_bits * level)) & (slots - 1);
+            for (uint32_t i = take_bucket(level * slots + slot); i != nil;) {
+                const uint32_t next = nodes[i].next;
+                link(i);
+                i = next;
+            }
+        }
+        for (uint32_t i = take_bucket(current & (slots - 1)); i != nil;) {
+            timer_node &n = nodes[i];
+            const uint32_t next = n.next;
+            if (n.expires <= current) {
+                n.state = node_state::running;
+                --armed;
+                ++in_flight;
+                due.push_back(timer_id{i, n.generation});
+            } else {
+                // Clamped to the wheel's range; file it again.
+                link(i);
+            }
+            i = next;
+        }
+    }
+
+    // Earliest tick worth waking up for: the next non-empty slot of level 0,
+    // or level 0's wrap, where higher levels cascade.
+    uint64_t next_wakeup() const {
+        const uint64_t wrap = (current | (slots - 1)) + 1;
+        for (uint64_t t = current + 1; t < wrap; ++t) {
+            if (buckets[t & (slots - 1)] != nil) {
+                return t;
+            }
+        }
+        return wrap;
+    }
+
+    void release(uint32_t index) {
+        timer_node &n = nodes[index];
+        n.state = node_state::free;
+        ++n.generation;
+        free_nodes.push_back(index);
+    }
+
+    void run_timer_thread() {
+        std::vector<timer_id> due;
+        std::unique_lock lock(mutex);
+        while (!stopping) {
+            const uint64_t target = elapsed_ticks();
+            while (current < target && armed > 0) {
+                tick(due);
+            }
+            current = std::max(current, target);
+            if (!due.empty()) {
+                lock.unlock();
+                for (timer_id id: due) {
+                    executor.execute(fire_task(this, id));
+                }
+                due.clear();
+                lock.lock();
+                continue;
+            }
+            if (armed == 0) {
+                sleeping_until = UINT64_MAX;
+                wakeup.wait(lock);
+            } else {
+                sleeping_until = next_wakeup();
+                wakeup.wait_until(lock, time_of(sleeping_until));
+            }
+        }
+    }
+
+    // Runs on the executor. Periodic timers are armed again only after the
+    // call returns, so runs of one timer never overlap.
+    void fire(timer_id id) {
+        timer_node *node;
+        {
+            std::lock_guard lock(mutex);
+            node = &nodes[id.index];
+        }
+        try {
+            node->fn();
+        } catch (...) {
+            settle(id);
+            throw;
+        }
+        settle(id);
+    }
+
+    // After a run, or in place of one the executor dropped: arm a periodic
+    // timer again, or free the node.
+    void settle(timer_id id) {
+        function_wapper dropped;
+        std::lock_guard lock(mutex);
+        timer_node &n = nodes[id.index];
+        if (n.period != 0 && !n.cancelled && !stopping) {
+            n.state = node_state::armed;
+            // Fixed rate; after an overrun the next run is due right away.
+            n.expires = std::max(n.expires + n.period, current + 1);
+            link(id.index);
+            ++armed;
+            if (n.expires < sleeping_until) {
+                wakeup.notify_one();
+            }
+        } else {
+            dropped = std::move(n.fn);
+            release(id.index);
+        }
+        if (--in_flight == 0) {
+            idle.notify_all();
+        }
+    }
+
+    template<typename F>
+    timer_id insert(clock::duration delay, clock::duration period, F &&fn) {
+        std::lock_guard lock(mutex);
+        if (stopping) {
+            return timer_id{};
+        }
+        uint32_t index;
+        if (!free_nodes.empty()) {
+            index = free_nodes.back();
+            free_nodes.pop_back();
+        } else {
+            index = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        timer_node &n = nodes[index];
+        n.fn = function_wapper(std::forward<F>(fn));
+        n.expires = std::max(deadline_tick(clock::now() + delay), current + 1);
+        n.period = period.count() > 0
+                   ? std::max<uint64_t>(1, std::chrono::ceil<std::chrono::milliseconds>(period).count()) : 0;
+        n.state = node_state::armed;
+        n.cancelled = false;
+        link(index);
+        ++armed;
+        if (n.expires < sleeping_until) {
+            wakeup.notify_one();
+        }
+        return timer_id{index, n.generation};
+    }
+
+public:
+    explicit timer_service(Executor &executor_) : executor(executor_), epoch(clock::now()) {
+        buckets.fill(nil);
+        worker = std::thread(&timer_service::run_timer_thread, this);
+    }
+
+    timer_service(const timer_service &) = delete;
+
+    timer_service &operator=(const timer_service &) = delete;
+
+    ~timer_service() { stop(); }
+
+    template<typename F>
+    timer_id schedule_after(clock::duration delay, F &&fn) {
+        return insert(delay, clock::duration::zero(), std::forward<F>(fn));
+    }
+
+    // First run after one period, then every period.
+    template<typename F>
+    timer_id schedule_every(clock::duration period, F &&fn) {
+        return insert(period, period, std::forward<F>(fn));
+    }
+
+    // True if this stopped a future run: a pending timer, or a periodic one
+    // whose current run will be its last.
+    bool cancel(timer_id id) {
+        function_wapper dropped;
+        std::lock_guard lock(mutex);
+        if (!id.valid() || id.index >= nodes.size()) {
+            return false;
+        }
+        timer_node &n = nodes[id.index];
+        if (n.generation != id.generation || n.state == node_state::free || n.cancelled) {
+            return false;
+        }
+        if (n.state == node_state::running) {
+            n.cancelled = true;
+            return n.period != 0;
+        }
+        unlink(id.index);
+        --armed;
+        dropped = std::move(n.fn);
+        release(id.index);
+        return true;
+    }
+
+    size_t pending() {
+        std::lock_guard lock(mutex);
+        return armed;
+    }
+
+    // Stops the timer thread; pending timers never fire. Timers already handed
+    // to the executor still run once, or are dropped by it, before this
+    // returns, so the service can be destroyed right after. Not to be called
+    // from a timer's callable, which would wait for itself.
+    void stop() {
+        request_stop();
+        std::unique_lock lock(mutex);
+        idle.wait(lock, [this] { return in_flight == 0; });
+    }
+
+    // Stops the timer thread without waiting for the executor; for an owner
+    // that has to settle the handed-over timers itself first.
+    void request_stop() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+};
+
+#endif //CPP_CONCURRENCY_TIMER_SERVICE_H
@@ -0,0 +1,218 @@
+//
+// Created by csq on 10/18/26.
+//
+
+#ifndef CPP_CONCURRENCY_TOPOLOGY_H
+#define CPP_CONCURRENCY_TOPOLOGY_H
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct cpu_info {
+    unsigned cpu = 0;
+    unsigned core = 0;
+    unsigned package = 0;
+    unsigned node = 0;
+};
+
+// Logical CPUs this process may run on, read from sysfs. Without sysfs (or on
+// other systems) every CPU is reported as its own core on node 0.
+struct cpu_topology {
+    std::vector<cpu_info> cpus;
+    unsigned node_count = 1;
+
+    // Parse a sysfs cpu list such as "0-3,8,10-11".
+    static std::vector<unsigned> parse_cpu_list(const std::string &list) {
+        std::vector<unsigned> result;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ',')) {
+            if (range.empty() || range == "\n") {
+                continue;
+            }
+            const auto dash = range.find('-');
+            try {
+                const unsigned first = std::stoul(range.substr(0, dash));
+                const unsigned last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+                for (unsigned cpu = first; cpu <= last; ++cpu) {
+                    result.push_back(cpu);
+                }
+            } catch (const std::exception &) {
+                return {};
+            }
+        }
+        return result;
+    }
+
+    static bool read_line(const std::string &path, std::string &line) {
+        std::ifstream in(path);
+        return static_cast<bool>(std::getline(in, line));
+    }
+
+    static bool read_number(const std::string &path, unsigned &value) {
+        std::string line;
+        if (!read_line(path, line)) {
+            return false;
+        }
+        try {
+            value = std::stoul(line);
+        } catch (const std::exception &) {
+            return false;
+        }
+        return true;
+    }
+
+    // sysfs_root is a parameter so tests can point it at a fake tree.
+    static cpu_topology read(const std::string &sysfs_root = "/sys/devices/system") {
+        cpu_topology topology;
+        std::string line;
+        std::vector<unsigned> online;
+        if (read_line(sysfs_root + "/cpu/online", line)) {
+            online = parse_cpu_list(line);
+        }
+        if (online.empty()) {
+            const unsigned count = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned cpu = 0; cpu < count; ++cpu) {
+                online.push_back(cpu);
+            }
+        }
+        for (unsigned cpu: online) {
+            cpu_info info;
+            info.cpu = cpu;
+            info.core = cpu;
+            const std::string dir = sysfs_root + "/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            read_number(dir + "core_id", info.core);
+            read_number(dir + "physical_package_id", info.package);
+            topology.cpus.push_back(info);
+        }
+
+        std::vector<unsigned> nodes;
+        if (read_line(sysfs_root + "/node/online", line)) {
+            nodes = parse_cpu_list(line);
+        }
+        for (unsigned node: nodes) {
+            if (!read_line(sysfs_root + "/node/node" + std::to_string(node) + "/cpulist", line)) {
+                continue;
+            }
+            for (unsigned cpu: parse_cpu_list(line)) {
+                for (auto &info: topology.cpus) {
+                    if (info.cpu == cpu) {
+                        info.node = node;
+                    }
+                }
+            }
+        }
+        topology.renumber_nodes();
+        return topology;
+    }
+
+    // Drop CPUs outside the calling thread's affinity mask (taskset, cgroups).
+    void restrict_to_allowed_cpus() {
+#if defined(__linux__)
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            return;
+        }
+        std::vector<cpu_info> usable;
+        for (const auto &info: cpus) {
+            if (info.cpu < CPU_SETSIZE && CPU_ISSET(info.cpu, &allowed)) {
+                usable.push_back(info);
+            }
+        }
+        if (!usable.empty()) {
+            cpus = std::move(usable);
+            renumber_nodes();
+        }
+#endif
+    }
+
+    // Order in which to hand CPUs to workers: node by node, and inside a node
+    // one hardware thread per physical core before any core gets a second one.
+    std::vector<cpu_info> placement_order() const {
+        std::vector<cpu_info> order = cpus;
+        std::vector<unsigned> sibling_rank(order.size(), 0);
+        std::sort(order.begin(), order.end(), [](const cpu_info &a, const cpu_info &b) {
+            return std::tie(a.node, a.package, a.core, a.cpu) < std::tie(b.node, b.package, b.core, b.cpu);
+        });
+        for (size_t i = 1; i < order.size(); ++i) {
+            const bool same_core = order[i].node == order[i - 1].node && order[i].package == order[i - 1].package &&
+                                   order[i].core == order[i - 1].core;
+            sibling_rank[i] = same_core ? sibling_rank[i - 1] + 1 : 0;
+        }
+        std::vector<size_t> index(order.size());
+        for (size_t i = 0; i < index.size(); ++i) {
+            index[i] = i;
+        }
+        std::stable_sort(index.begin(), index.end(), [&](size_t a, size_t b) {
+            return std::tie(order[a].node, sibling_rank[a]) < std::tie(order[b].node, sibling_rank[b]);
+        });
+        std::vector<cpu_info> result;
+        result.reserve(order.size());
+        for (size_t i: index) {
+            result.push_back(order[i]);
+        }
+        return result;
+    }
+
+    unsigned node_of_cpu(unsigned cpu) const {
+        for (const auto &info: cpus) {
+            if (info.cpu == cpu) {
+                return info.node;
+            }
+        }
+        return 0;
+    }
+
+private:
+    // Map node ids to 0..node_count-1 (node ids in sysfs may have holes).
+    void renumber_nodes() {
+        std::vector<unsigned> ids;
+        for (const auto &info: cpus) {
+            ids.push_back(info.node);
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        for (auto &info: cpus) {
+            info.node = static_cast<unsigned>(std::lower_bound(ids.begin(), ids.end(), info.node) - ids.begin());
+        }
+        node_count = std::max<unsigned>(1, static_cast<unsigned>(ids.size()));
+    }
+};
+
+inline bool pin_thread_to_cpu(std::thread &t, unsigned cpu) {
+#if defined(__linux__)
+    if (cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(t.native_handle(), sizeof(set), &set) == 0;
+#else
+    (void) t;
+    (void) cpu;
+    return false;
+#endif
+}
+
+// CPU the calling thread is running on right now, or -1 if unknown.
+inline int current_cpu() {
+#if defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+#endif //CPP_CONCURRENCY_TOPOLOGY_H
@@ -0,0 +1,179 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/actor.h"
+#include "gtest/gtest.h"
+
+struct tagged {
+    int sender;
+    int sequence;
+};
+
+// Checks per-sender order and that receive() never overlaps itself.
+class order_checker : public actor<tagged> {
+public:
+    std::vector<int> next;
+    std::atomic<int> received{0};
+    std::atomic<int> inside{0};
+    bool out_of_order = false;
+    bool overlapped = false;
+
+    order_checker(thread_pool &pool, int senders) : actor(pool), next(senders, 0) {}
+
+protected:
+    void receive(tagged &m) override {
+        if (inside.fetch_add(1) != 0) {
+            overlapped = true;
+        }
+        if (next[m.sender] != m.sequence) {
+            out_of_order = true;
+        }
+        next[m.sender] = m.sequence + 1;
+        inside.fetch_sub(1);
+        received.fetch_add(1, std::memory_order_release);
+    }
+};
+
+TEST(ActorTest, OrderTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+    constexpr int senders = 4;
+    constexpr int per_sender = 20000;
+    auto checker = std::make_shared<order_checker>(pool, senders);
+
+    std::vector<std::thread> threads;
+    for (int s = 0; s < senders; ++s) {
+        threads.emplace_back([&, s] {
+            for (int i = 0; i < per_sender; ++i) {
+                checker->send(tagged{s, i});
+            }
+        });
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+    while (checker->received.load(std::memory_order_acquire) < senders * per_sender) {
+        std::this_thread::yield();
+    }
+    EXPECT_FALSE(checker->out_of_order);
+    EXPECT_FALSE(checker->overlapped);
+}
+
+class ping_pong : public actor<int> {
+public:
+    std::shared_ptr<ping_pong> peer;
+    std::atomic<int> *last;
+
+    ping_pong(thread_pool &pool, std::atomic<int> *last_) : actor(pool), last(last_) {}
+
+protected:
+    void receive(int &n) override {
+        if (n == 0) {
+            last->store(1, std::memory_order_release);
+            return;
+        }
+        peer->send(n - 1);
+    }
+};
+
+TEST(ActorTest, PingPongTest) {
+    thread_pool_options options;
+    options.thread_count = 2;
+    thread_pool pool(options);
+    std::atomic<int> finished{0};
+    auto a = std::make_shared<ping_pong>(pool, &finished);
+    auto b = std::make_shared<ping_pong>(pool, &finished);
+    a->peer = b;
+    b->peer = a;
+    a->send(10001);
+    while (!finished.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    // Break the cycle so both can go.
+    a->peer.reset();
+    b->peer.reset();
+}
+
+class counter : public actor<std::string> {
+public:
+    std::atomic<int> count{0};
+    // Count of another actor at the time this one got its first message.
+    const counter *watched = nullptr;
+    std::atomic<int> watched_count{-1};
+
+    counter(thread_pool &pool, size_t batch) : actor(pool, batch) {}
+
+protected:
+    void receive(std::string &) override {
+        if (watched && watched_count.load() < 0) {
+            watched_count.store(watched->count.load());
+        }
+        count.fetch_add(1, std::memory_order_release);
+    }
+};
+
+TEST(ActorTest, BatchFairnessTest) {
+    // One worker: a flooded actor must still let another one run.
+    thread_pool_options options;
+    options.thread_count = 1;
+    thread_pool pool(options);
+    auto flooded = std::make_shared<counter>(pool, 8);
+    auto quiet = std::make_shared<counter>(pool, 8);
+    quiet->watched = flooded.get();
+
+    // Hold the worker until both actors have been scheduled.
+    std::atomic<bool> started{false};
+    std::atomic<bool> open{false};
+    pool.execute([&] {
+        started = true;
+        while (!open) {
+            std::this_thread::yield();
+        }
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < 1000; ++i) {
+        flooded->send("x");
+    }
+    quiet->send(std::string(3, 'y'));
+    open = true;
+    while (quiet->count.load(std::memory_order_acquire) == 0 ||
+           flooded->count.load(std::memory_order_acquire) < 1000) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(quiet->watched_count.load(), 8);
+}
+
+TEST(ActorTest, FullPoolTest) {
+    // A rejected activation would leave the actor scheduled and deaf for good.
+    thread_pool_options options;
+    options.thread_count = 1;
+    options.queue_capacity = 1;
+    options.overflow = overflow_policy::reject;
+    thread_pool pool(options);
+    std::atomic<bool> open{false};
+    pool.execute([&open] {
+        while (!open) {
+            std::this_thread::yield();
+        }
+    });
+    pool.execute([] {});
+    auto checker = std::make_shared<order_checker>(pool, 1);
+    for (int i = 0; i < 10; ++i) {
+        checker->send(tagged{0, i});
+    }
+    EXPECT_EQ(checker->received.load(), 0);
+    open = true;
+    while (checker->received.load(std::memory_order_acquire) < 10) {
+        std::this_thread::yield();
+    }
+    EXPECT_FALSE(checker->out_of_order);
+}
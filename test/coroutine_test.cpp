@@ -0,0 +1,141 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "utils/coroutine_task.h"
+#include "gtest/gtest.h"
+
+// Built as C++20 with -DCPP_CONCURRENCY_COROUTINES=ON; empty otherwise.
+#if CPP_CONCURRENCY_HAS_COROUTINES
+
+task<int> square_on(thread_pool &pool, int v) {
+    co_await pool.schedule();
+    co_return v * v;
+}
+
+task<int> sum_of_squares(thread_pool &pool, int n) {
+    co_await pool.schedule();
+    int sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += co_await square_on(pool, i);
+    }
+    co_return sum;
+}
+
+task<> fail_on(thread_pool &pool) {
+    co_await pool.schedule();
+    throw std::runtime_error("coroutine failed");
+}
+
+TEST(CoroutineTest, ScheduleTest) {
+    thread_pool pool;
+    auto caller = std::this_thread::get_id();
+    auto on_worker = [&]() -> task<bool> {
+        co_await pool.schedule();
+        co_return std::this_thread::get_id() != caller;
+    };
+    EXPECT_TRUE(sync_wait(on_worker()));
+}
+
+TEST(CoroutineTest, NestedTaskTest) {
+    thread_pool pool;
+    EXPECT_EQ(sync_wait(sum_of_squares(pool, 100)), 328350);
+}
+
+TEST(CoroutineTest, ExceptionTest) {
+    thread_pool pool;
+    EXPECT_THROW(sync_wait(fail_on(pool)), std::runtime_error);
+}
+
+TEST(CoroutineTest, ManyCoroutinesTest) {
+    thread_pool pool;
+    std::atomic<int> resumed{0};
+    auto worker = [&]() -> task<> {
+        for (int i = 0; i < 100; ++i) {
+            co_await pool.schedule();
+            resumed.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+    auto fan_out = [&]() -> task<> {
+        for (int i = 0; i < 50; ++i) {
+            co_await worker();
+        }
+    };
+    sync_wait(fan_out());
+    EXPECT_EQ(resumed, 5000);
+}
+
+// One worker held on a gate, so a schedule() from here stays queued.
+struct gated {
+    std::atomic<bool> started{false};
+    std::atomic<bool> open{false};
+    thread_pool pool;
+
+    gated(size_t capacity, overflow_policy overflow) : pool([&] {
+        thread_pool_options options;
+        options.thread_count = 1;
+        options.queue_capacity = capacity;
+        options.overflow = overflow;
+        return options;
+    }()) {
+        pool.execute([this] {
+            started = true;
+            while (!open) {
+                std::this_thread::yield();
+            }
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+    }
+
+    ~gated() { open = true; }
+};
+
+TEST(CoroutineTest, RejectedScheduleTest) {
+    gated g(1, overflow_policy::reject);
+    g.pool.execute([] {});
+    bool after = false;
+    auto body = [&]() -> task<> {
+        co_await g.pool.schedule();
+        after = true;
+    };
+    EXPECT_THROW(sync_wait(body()), task_rejected);
+    EXPECT_FALSE(after);
+}
+
+TEST(CoroutineTest, CancelledScheduleTest) {
+    gated g(0, overflow_policy::block);
+    std::atomic<bool> threw{false};
+    std::thread waiter([&] {
+        auto body = [&]() -> task<> { co_await g.pool.schedule(); };
+        try {
+            sync_wait(body());
+        } catch (const task_cancelled &) {
+            threw = true;
+        }
+    });
+    while (g.pool.lane_metrics(task_priority::normal).depth == 0) {
+        std::this_thread::yield();
+    }
+    std::thread stopper([&] { g.pool.shutdown(shutdown_mode::cancel); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    g.open = true;
+    stopper.join();
+    waiter.join();
+    EXPECT_TRUE(threw.load());
+}
+
+#else
+
+TEST(CoroutineTest, LayerDisabledTest) {
+    // Pre-C++20 builds still get the plain pool.
+    thread_pool pool;
+    EXPECT_EQ(pool.submit([] { return 1; }).get(), 1);
+}
+
+#endif
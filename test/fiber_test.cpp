@@ -0,0 +1,243 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "data_structure/fiber_queue.h"
+#include "lock/fiber_rwlock.h"
+#include "lock/fiber_semaphore.h"
+#include "utils/fiber.h"
+#include "gtest/gtest.h"
+
+TEST(FiberTest, StackPoolTest) {
+    fiber_stack_pool stacks(10000, 2);
+    EXPECT_EQ(stacks.get_stack_size() % 4096, 0u);
+    EXPECT_GE(stacks.get_stack_size(), 10000u);
+
+    fiber_stack a = stacks.acquire();
+    fiber_stack b = stacks.acquire();
+    fiber_stack c = stacks.acquire();
+    // The usable part is writable end to end.
+    static_cast<char *>(a.bottom)[0] = 1;
+    static_cast<char *>(a.bottom)[a.size - 1] = 1;
+    stacks.release(a);
+    stacks.release(b);
+    stacks.release(c);
+    EXPECT_EQ(stacks.cached(), 2u);
+    fiber_stack d = stacks.acquire();
+    EXPECT_EQ(d.bottom, b.bottom);
+    stacks.release(d);
+}
+
+TEST(FiberTest, ResultAndExceptionTest) {
+    thread_pool_options options;
+    options.thread_count = 2;
+    thread_pool pool(options);
+
+    auto value = spawn_fiber(pool, [] {
+        EXPECT_NE(fiber::current(), nullptr);
+        fiber_yield();
+        return 42;
+    });
+    EXPECT_EQ(value.get(), 42);
+    EXPECT_EQ(fiber::current(), nullptr);
+
+    auto error = spawn_fiber(pool, []() -> int { throw std::runtime_error("fiber"); });
+    EXPECT_THROW(error.get(), std::runtime_error);
+}
+
+TEST(FiberTest, ManyBlockedFibersTest) {
+    // Every fiber blocks until all of them have arrived: 2 workers could not
+    // hold 10000 blocked threads, but they can hold 10000 suspended fibers.
+    thread_pool_options options;
+    options.thread_count = 2;
+    thread_pool pool(options);
+
+    constexpr int count = 10000;
+    fiber_semaphore gate(0);
+    std::atomic<int> arrived{0};
+    std::atomic<int> passed{0};
+    std::vector<task_future<void>> fibers;
+    for (int i = 0; i < count; ++i) {
+        fibers.push_back(spawn_fiber(pool, [&] {
+            if (arrived.fetch_add(1) + 1 == count) {
+                for (int j = 0; j < count; ++j) {
+                    gate.release();
+                }
+            }
+            gate.acquire();
+            passed.fetch_add(1);
+        }));
+    }
+    for (auto &f: fibers) {
+        f.get();
+    }
+    EXPECT_EQ(passed.load(), count);
+}
+
+TEST(FiberTest, SemaphoreMixedTest) {
+    // Fibers and plain threads waiting on the same semaphore.
+    thread_pool_options options;
+    options.thread_count = 1;
+    thread_pool pool(options);
+
+    fiber_semaphore sem(0);
+    std::atomic<int> done{0};
+    std::vector<task_future<void>> fibers;
+    for (int i = 0; i < 100; ++i) {
+        fibers.push_back(spawn_fiber(pool, [&] {
+            sem.acquire();
+            done.fetch_add(1);
+        }));
+    }
+    std::thread blocked([&] {
+        sem.acquire();
+        done.fetch_add(1);
+    });
+    for (int i = 0; i < 101; ++i) {
+        sem.release();
+    }
+    blocked.join();
+    for (auto &f: fibers) {
+        f.get();
+    }
+    EXPECT_EQ(done.load(), 101);
+    EXPECT_FALSE(sem.try_acquire());
+}
+
+TEST(FiberTest, RwlockTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+
+    fiber_rwlock lock;
+    std::atomic<int> readers{0};
+    std::atomic<int> writers{0};
+    std::atomic<bool> violated{false};
+    long value = 0;
+    std::vector<task_future<void>> fibers;
+    for (int i = 0; i < 200; ++i) {
+        fibers.push_back(spawn_fiber(pool, [&, i] {
+            for (int round = 0; round < 20; ++round) {
+                if ((i + round) % 5 == 0) {
+                    lock.WLock();
+                    if (writers.fetch_add(1) != 0 || readers.load() != 0) {
+                        violated = true;
+                    }
+                    ++value;
+                    fiber_yield();
+                    writers.fetch_sub(1);
+                    lock.WUnLock();
+                } else {
+                    lock.RLock();
+                    readers.fetch_add(1);
+                    if (writers.load() != 0) {
+                        violated = true;
+                    }
+                    fiber_yield();
+                    readers.fetch_sub(1);
+                    lock.RUnLock();
+                }
+            }
+        }));
+    }
+    for (auto &f: fibers) {
+        f.get();
+    }
+    EXPECT_FALSE(violated.load());
+    EXPECT_EQ(value, 200 * 20 / 5);
+}
+
+TEST(FiberTest, QueueTest) {
+    // Consumers outnumber the workers and park in wait_and_pop.
+    thread_pool_options options;
+    options.thread_count = 2;
+    thread_pool pool(options);
+
+    fiber_queue<int> queue;
+    std::atomic<long> sum{0};
+    std::vector<task_future<void>> consumers;
+    for (int i = 0; i < 50; ++i) {
+        consumers.push_back(spawn_fiber(pool, [&] {
+            for (;;) {
+                int v;
+                queue.wait_and_pop(v);
+                if (v < 0) {
+                    return;
+                }
+                sum.fetch_add(v);
+            }
+        }));
+    }
+    auto producer = spawn_fiber(pool, [&] {
+        for (int v = 1; v <= 10000; ++v) {
+            queue.push(v);
+        }
+        for (int i = 0; i < 50; ++i) {
+            queue.push(-1);
+        }
+    });
+    producer.get();
+    for (auto &c: consumers) {
+        c.get();
+    }
+    EXPECT_EQ(sum.load(), 10000L * 10001 / 2);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(FiberTest, CancelledFiberTest) {
+    // A fiber woken after its pool has shut down cannot run again: its stack
+    // is freed and its future fails.
+    fiber_stack_pool stacks;
+    fiber_semaphore sem(0);
+    std::atomic<bool> waiting{false};
+    thread_pool_options options;
+    options.thread_count = 1;
+    thread_pool pool(options);
+    auto f = spawn_fiber(pool, stacks, [&] {
+        waiting = true;
+        sem.acquire();
+    });
+    while (!waiting.load()) {
+        std::this_thread::yield();
+    }
+    pool.shutdown(shutdown_mode::cancel);
+    EXPECT_EQ(stacks.cached(), 0u);
+    sem.release();
+    EXPECT_THROW(f.get(), task_cancelled);
+    EXPECT_EQ(stacks.cached(), 1u);
+}
+
+TEST(FiberTest, FullPoolTest) {
+    // With the queue full, caller_runs must not run the woken fiber on the
+    // releasing thread, which would relock the semaphore's mutex it holds.
+    thread_pool_options options;
+    options.thread_count = 1;
+    options.queue_capacity = 2;
+    options.overflow = overflow_policy::caller_runs;
+    thread_pool pool(options);
+    fiber_semaphore sem(0);
+    auto f = spawn_fiber(pool, [&sem] { sem.acquire(); });
+    std::atomic<bool> started{false};
+    std::atomic<bool> open{false};
+    pool.execute([&] {
+        started = true;
+        while (!open) {
+            std::this_thread::yield();
+        }
+    });
+    // One worker: the fiber is suspended in acquire() once this task runs.
+    while (!started) {
+        std::this_thread::yield();
+    }
+    pool.execute([] {});
+    pool.execute([] {});
+    sem.release();
+    EXPECT_EQ(pool.backpressure().ran_on_caller, 0u);
+    open = true;
+    f.get();
+}
@@ -0,0 +1,78 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "data_structure/mpsc_queue.h"
+#include "gtest/gtest.h"
+
+struct int_node : mpsc_node {
+    int producer;
+    int value;
+
+    int_node(int producer_, int value_) : producer(producer_), value(value_) {}
+};
+
+TEST(MpscQueueTest, SingleThreadTest) {
+    intrusive_mpsc_queue queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.pop(), nullptr);
+
+    std::vector<std::unique_ptr<int_node>> nodes;
+    for (int i = 0; i < 5; ++i) {
+        nodes.push_back(std::make_unique<int_node>(0, i));
+        queue.push(nodes.back().get());
+    }
+    EXPECT_FALSE(queue.empty());
+    for (int i = 0; i < 5; ++i) {
+        auto *n = static_cast<int_node *>(queue.pop());
+        ASSERT_NE(n, nullptr);
+        EXPECT_EQ(n->value, i);
+    }
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.pop(), nullptr);
+
+    // Nodes can go round again once popped.
+    queue.push(nodes[3].get());
+    EXPECT_EQ(queue.pop(), nodes[3].get());
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.pop(), nullptr);
+    EXPECT_TRUE(queue.drained());
+    queue.push(nodes[4].get());
+    EXPECT_FALSE(queue.drained());
+    EXPECT_EQ(queue.pop(), nodes[4].get());
+    EXPECT_TRUE(queue.drained());
+}
+
+TEST(MpscQueueTest, MultiProducerTest) {
+    intrusive_mpsc_queue queue;
+    constexpr int producers = 4;
+    constexpr int per_producer = 50000;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p] {
+            for (int i = 0; i < per_producer; ++i) {
+                queue.push(new int_node(p, i));
+            }
+        });
+    }
+    std::vector<int> next(producers, 0);
+    int received = 0;
+    while (received < producers * per_producer) {
+        std::unique_ptr<int_node> n(static_cast<int_node *>(queue.pop()));
+        if (!n) {
+            std::this_thread::yield();
+            continue;
+        }
+        EXPECT_EQ(n->value, next[n->producer]);
+        next[n->producer] = n->value + 1;
+        ++received;
+    }
+    for (auto &t: threads) {
+        t.join();
+    }
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.pop(), nullptr);
+}
@@ -0,0 +1,193 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "algorithm/parallel_pipeline.h"
+#include "gtest/gtest.h"
+
+static filter<void, int> count_to(int n) {
+    return make_filter<void, int>(filter_mode::serial_in_order, [i = 0, n](flow_control &flow) mutable {
+        if (i == n) {
+            flow.stop();
+            return 0;
+        }
+        return i++;
+    });
+}
+
+TEST(ParallelPipelineTest, InOrderTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+
+    std::vector<long> out;
+    parallel_pipeline(pool, 8,
+                      count_to(1000) &
+                      make_filter<int, long>(filter_mode::parallel, [](int i) {
+                          if (i % 7 == 0) {
+                              std::this_thread::sleep_for(std::chrono::microseconds(100));
+                          }
+                          return static_cast<long>(i) * i;
+                      }) &
+                      make_filter<long, void>(filter_mode::serial_in_order, [&out](long v) { out.push_back(v); }));
+    ASSERT_EQ(out.size(), 1000u);
+    for (long i = 0; i < 1000; ++i) {
+        EXPECT_EQ(out[i], i * i);
+    }
+}
+
+TEST(ParallelPipelineTest, TokenLimitTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+
+    std::atomic<int> in_flight{0};
+    std::atomic<int> peak{0};
+    std::atomic<int> done{0};
+    parallel_pipeline(pool, 3,
+                      make_filter<void, int>(filter_mode::serial_in_order, [&, i = 0](flow_control &flow) mutable {
+                          if (i == 200) {
+                              flow.stop();
+                              return 0;
+                          }
+                          int now = in_flight.fetch_add(1) + 1;
+                          int seen = peak.load();
+                          while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+                          }
+                          return i++;
+                      }) &
+                      make_filter<int, int>(filter_mode::parallel, [](int i) {
+                          std::this_thread::sleep_for(std::chrono::microseconds(50));
+                          return i;
+                      }) &
+                      make_filter<int, void>(filter_mode::parallel, [&](int) {
+                          done.fetch_add(1);
+                          in_flight.fetch_sub(1);
+                      }));
+    EXPECT_EQ(done.load(), 200);
+    EXPECT_LE(peak.load(), 3);
+    EXPECT_GE(peak.load(), 1);
+}
+
+TEST(ParallelPipelineTest, SerialOutOfOrderTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+
+    std::atomic<int> inside{0};
+    bool overlapped = false;
+    std::vector<int> seen(500, 0);
+    parallel_pipeline(pool, 16,
+                      count_to(500) &
+                      make_filter<int, int>(filter_mode::parallel, [](int i) {
+                          if (i % 3 == 0) {
+                              std::this_thread::yield();
+                          }
+                          return i;
+                      }) &
+                      make_filter<int, void>(filter_mode::serial_out_of_order, [&](int i) {
+                          if (inside.fetch_add(1) != 0) {
+                              overlapped = true;
+                          }
+                          ++seen[i];
+                          inside.fetch_sub(1);
+                      }));
+    EXPECT_FALSE(overlapped);
+    for (int count: seen) {
+        EXPECT_EQ(count, 1);
+    }
+}
+
+TEST(ParallelPipelineTest, ExceptionTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+
+    std::atomic<int> produced{0};
+    EXPECT_THROW(parallel_pipeline(pool, 4,
+                                   make_filter<void, int>(filter_mode::serial_in_order,
+                                                          [&, i = 0](flow_control &) mutable {
+                                                              ++produced;
+                                                              return i++;
+                                                          }) &
+                                   make_filter<int, void>(filter_mode::parallel,
+                                                          [](int i) {
+                                                              if (i == 50) {
+                                                                  throw std::runtime_error("bad item");
+                                                              }
+                                                          })),
+                 std::runtime_error);
+    // The input never stops by itself; the failure stopped it.
+    EXPECT_GE(produced.load(), 51);
+
+    // The pool is still usable.
+    int sum = 0;
+    parallel_pipeline(pool, 4, count_to(10) & make_filter<int, void>(filter_mode::serial_in_order,
+                                                                     [&sum](int i) { sum += i; }));
+    EXPECT_EQ(sum, 45);
+}
+
+TEST(ParallelPipelineTest, SingleWorkerTest) {
+    thread_pool_options options;
+    options.thread_count = 1;
+    thread_pool pool(options);
+
+    std::string out;
+    parallel_pipeline(pool, 4,
+                      count_to(26) &
+                      make_filter<int, char>(filter_mode::parallel, [](int i) { return static_cast<char>('a' + i); }) &
+                      make_filter<char, char>(filter_mode::serial_out_of_order, [](char c) { return c; }) &
+                      make_filter<char, void>(filter_mode::serial_in_order, [&out](char c) { out += c; }));
+    EXPECT_EQ(out, "abcdefghijklmnopqrstuvwxyz");
+
+    // From inside a task the caller helps instead of blocking its worker.
+    auto nested = pool.submit([&pool] {
+        int total = 0;
+        parallel_pipeline(pool, 2, count_to(100) & make_filter<int, void>(filter_mode::serial_in_order,
+                                                                          [&total](int i) { total += i; }));
+        return total;
+    });
+    EXPECT_EQ(nested.get(), 4950);
+}
+
+TEST(ParallelPipelineTest, ArgumentTest) {
+    thread_pool pool;
+    EXPECT_THROW(parallel_pipeline(pool, 0, count_to(1) & make_filter<int, void>(filter_mode::parallel, [](int) {})),
+                 std::invalid_argument);
+    EXPECT_THROW(parallel_pipeline(pool, 1, make_filter<void, void>(filter_mode::parallel, [](flow_control &f) {
+                     f.stop();
+                 })),
+                 std::invalid_argument);
+}
+
+TEST(ParallelPipelineTest, FullPoolTest) {
+    // With the queue full, caller_runs must not run the input task on the
+    // caller while it holds the pipeline's input lock.
+    thread_pool_options options;
+    options.thread_count = 1;
+    options.queue_capacity = 1;
+    options.overflow = overflow_policy::caller_runs;
+    thread_pool pool(options);
+    std::atomic<bool> open{false};
+    pool.execute([&open] {
+        while (!open) {
+            std::this_thread::yield();
+        }
+    });
+    pool.execute([] {});
+    std::thread opener([&open] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        open = true;
+    });
+    int sum = 0;
+    parallel_pipeline(pool, 4, count_to(100) & make_filter<int, void>(filter_mode::serial_in_order,
+                                                                      [&sum](int i) { sum += i; }));
+    opener.join();
+    EXPECT_EQ(sum, 4950);
+}
@@ -0,0 +1,73 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#define THREAD_POOL_ENABLE_STATS 1
+#include "utils/thread_pool.h"
+#include "gtest/gtest.h"
+
+TEST(PoolStatsTest, HistogramTest) {
+    EXPECT_EQ(latency_histogram::bucket_of(0), 0u);
+    EXPECT_EQ(latency_histogram::bucket_of(1), 0u);
+    EXPECT_EQ(latency_histogram::bucket_of(1000), 9u);
+    EXPECT_EQ(latency_histogram::bucket_of(int64_t(1) << 62), latency_histogram::bucket_count - 1);
+
+    latency_histogram h;
+    h.buckets[3] = 99;
+    h.buckets[10] = 1;
+    EXPECT_EQ(h.count(), 100u);
+    EXPECT_EQ(h.percentile(0.5).count(), 16);
+    EXPECT_EQ(h.percentile(1.0).count(), 2048);
+}
+
+TEST(PoolStatsTest, CountersTest) {
+    thread_pool_options options;
+    options.thread_count = 2;
+    thread_pool pool(options);
+
+    std::vector<task_future<void>> futures;
+    for (int i = 0; i < 200; ++i) {
+        futures.push_back(pool.submit([] { std::this_thread::sleep_for(std::chrono::microseconds(50)); }));
+    }
+    for (auto &f: futures) {
+        f.get();
+    }
+    // Spawned from a worker: lands on its deque, where the other can steal it.
+    pool.submit([&pool] {
+        std::vector<task_future<void>> children;
+        for (int i = 0; i < 50; ++i) {
+            children.push_back(pool.submit([] { std::this_thread::sleep_for(std::chrono::microseconds(50)); }));
+        }
+        for (auto &child: children) {
+            while (!child.is_ready()) {
+                pool.run_pending_task();
+            }
+        }
+    }).get();
+
+    // Counters are booked after the future is set, so give the last one a moment.
+    pool_stats stats = pool.stats();
+    for (int i = 0; i < 100 && stats.total().tasks_executed < 251; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        stats = pool.stats();
+    }
+    ASSERT_TRUE(stats.enabled);
+    ASSERT_EQ(stats.workers.size(), 2u);
+    const worker_stats total = stats.total();
+    EXPECT_EQ(total.tasks_executed, 251u);
+    EXPECT_EQ(total.queue_latency.count(), 251u);
+    EXPECT_EQ(total.run_latency.count(), 251u);
+    EXPECT_GE(total.run_latency.percentile(0.5), std::chrono::microseconds(50));
+    EXPECT_GE(total.busy, std::chrono::milliseconds(10));
+    EXPECT_GT(total.depth_samples, 0u);
+    EXPECT_GE(total.steal_attempts, total.steal_successes);
+
+    std::ostringstream dump;
+    dump << stats;
+    EXPECT_NE(dump.str().find("total: tasks=251"), std::string::npos);
+}
@@ -0,0 +1,84 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define THREAD_POOL_ENABLE_TRACING 1
+#include "utils/thread_pool.h"
+#include "gtest/gtest.h"
+
+static size_t count_of(const std::string &text, const std::string &needle) {
+    size_t count = 0;
+    for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+TEST(PoolTraceTest, RingTest) {
+    trace_ring ring(5);
+    EXPECT_EQ(ring.capacity(), 8u);
+    EXPECT_TRUE(ring.snapshot().empty());
+    for (uint64_t i = 0; i < 20; ++i) {
+        ring.record(i * 10, i * 10 + 5);
+    }
+    EXPECT_EQ(ring.recorded(), 20u);
+    // The oldest surviving slot may be mid-overwrite, so it is left out.
+    std::vector<trace_event> events = ring.snapshot();
+    ASSERT_EQ(events.size(), 7u);
+    for (size_t i = 0; i < events.size(); ++i) {
+        EXPECT_EQ(events[i].begin, (13 + i) * 10);
+        EXPECT_EQ(events[i].end, (13 + i) * 10 + 5);
+    }
+}
+
+TEST(PoolTraceTest, TimelineTest) {
+    thread_pool_options options;
+    options.thread_count = 2;
+    thread_pool pool(options);
+
+    std::vector<task_future<void>> futures;
+    for (int i = 0; i < 100; ++i) {
+        futures.push_back(pool.submit([] { std::this_thread::sleep_for(std::chrono::microseconds(50)); }));
+    }
+    for (auto &f: futures) {
+        f.get();
+    }
+    // A future is ready just before its task's end is recorded.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::ostringstream out;
+    pool.write_trace(out);
+    const std::string trace = out.str();
+    EXPECT_EQ(trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0), 0u);
+    EXPECT_EQ(count_of(trace, "\"ph\":\"M\""), 2u);
+    EXPECT_EQ(count_of(trace, "\"ph\":\"X\""), 100u);
+    EXPECT_NE(trace.find("\"args\":{\"name\":\"worker 1\"}"), std::string::npos);
+    EXPECT_EQ(trace.substr(trace.size() - 3), "]}\n");
+}
+
+TEST(PoolTraceTest, NestedTasksTest) {
+    // Children a worker runs while it waits are traced on the same track.
+    thread_pool_options options;
+    options.thread_count = 1;
+    thread_pool pool(options);
+    auto parent = pool.submit([&pool] {
+        std::vector<task_future<int>> children;
+        for (int i = 0; i < 10; ++i) {
+            children.push_back(pool.submit([i] { return i; }));
+        }
+        for (auto &child: children) {
+            pool.wait_and_help(child);
+        }
+    });
+    parent.get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::ostringstream out;
+    pool.write_trace(out);
+    EXPECT_EQ(count_of(out.str(), "\"ph\":\"X\""), 11u);
+}
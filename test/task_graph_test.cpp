@@ -0,0 +1,116 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/task_graph.h"
+#include "gtest/gtest.h"
+
+TEST(TaskGraphTest, DependencyOrderTest) {
+    thread_pool pool;
+    task_graph graph;
+
+    // Diamond: a -> (b, c) -> d
+    std::mutex m;
+    std::vector<char> order;
+    auto record = [&](char c) {
+        return [&, c] {
+            std::lock_guard lk(m);
+            order.push_back(c);
+        };
+    };
+    auto a = graph.add_node(record('a'));
+    auto b = graph.add_node(record('b'));
+    auto c = graph.add_node(record('c'));
+    auto d = graph.add_node(record('d'));
+    graph.add_edge(a, b);
+    graph.add_edge(a, c);
+    graph.add_edge(b, d);
+    graph.add_edge(c, d);
+
+    for (int run = 0; run < 100; ++run) {
+        order.clear();
+        graph.run(pool);
+        ASSERT_EQ(order.size(), 4);
+        EXPECT_EQ(order.front(), 'a');
+        EXPECT_EQ(order.back(), 'd');
+    }
+}
+
+TEST(TaskGraphTest, WideGraphTest) {
+    thread_pool pool;
+    task_graph graph;
+
+    std::atomic<int> sum{0};
+    auto root = graph.add_node([] {});
+    auto sink = graph.add_node([&] { EXPECT_EQ(sum.load(), 1000 * 999 / 2); });
+    for (int i = 0; i < 1000; ++i) {
+        auto n = graph.add_node([&, i] { sum += i; });
+        graph.add_edge(root, n);
+        graph.add_edge(n, sink);
+    }
+    graph.run(pool);
+    EXPECT_EQ(sum, 1000 * 999 / 2);
+}
+
+TEST(TaskGraphTest, ErrorTest) {
+    thread_pool pool;
+    task_graph graph;
+
+    std::atomic<bool> ran_after{false};
+    auto a = graph.add_node([] { throw std::runtime_error("node failed"); });
+    auto b = graph.add_node([&] { ran_after = true; });
+    graph.add_edge(a, b);
+    EXPECT_THROW(graph.run(pool), std::runtime_error);
+    EXPECT_FALSE(ran_after);
+
+    graph.add_edge(b, a);
+    EXPECT_THROW(graph.run(pool), std::logic_error);
+}
+
+TEST(TaskGraphTest, RejectedNodeTest) {
+    // A rejected root fails the run, but run() still waits for the node
+    // tasks already queued; they must not touch the graph after it returns.
+    thread_pool_options options;
+    options.thread_count = 1;
+    options.queue_capacity = 1;
+    options.overflow = overflow_policy::reject;
+    thread_pool pool(options);
+    std::atomic<bool> started{false};
+    std::atomic<bool> open{false};
+    pool.execute([&] {
+        started = true;
+        while (!open) {
+            std::this_thread::yield();
+        }
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+
+    task_graph graph;
+    std::atomic<int> ran{0};
+    auto a = graph.add_node([&ran] { ++ran; });
+    auto b = graph.add_node([&ran] { ++ran; });
+    auto c = graph.add_node([&ran] { ++ran; });
+    graph.add_edge(a, c);
+    graph.add_edge(b, c);
+    std::thread opener([&open] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        open = true;
+    });
+    EXPECT_THROW(graph.run(pool), task_rejected);
+    opener.join();
+    EXPECT_EQ(ran.load(), 0);
+    EXPECT_EQ(pool.backpressure().queued, 0u);
+
+    // Nothing of the failed run is left behind.
+    thread_pool unbounded;
+    ran = 0;
+    graph.run(unbounded);
+    EXPECT_EQ(ran.load(), 3);
+}
@@ -0,0 +1,122 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <list>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include "algorithm/quicksort.h"
+#include "utils/task_group.h"
+#include "gtest/gtest.h"
+
+static long long fib(thread_pool &pool, int n) {
+    if (n < 12) {
+        return n < 2 ? n : fib(pool, n - 1) + fib(pool, n - 2);
+    }
+    long long a = 0;
+    task_group group(pool);
+    group.run([&] { a = fib(pool, n - 1); });
+    long long b = fib(pool, n - 2);
+    group.wait();
+    return a + b;
+}
+
+TEST(TaskGroupTest, RunAndWaitTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+    task_group group(pool);
+
+    std::atomic<int> sum{0};
+    for (int i = 1; i <= 1000; ++i) {
+        group.run([&sum, i] { sum.fetch_add(i, std::memory_order_relaxed); });
+    }
+    group.wait();
+    EXPECT_EQ(sum.load(), 500500);
+
+    // Reusable after wait().
+    group.run([&sum] { sum.fetch_add(1); });
+    group.wait();
+    EXPECT_EQ(sum.load(), 500501);
+}
+
+TEST(TaskGroupTest, NestedGroupsTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+    EXPECT_EQ(fib(pool, 25), 75025);
+}
+
+TEST(TaskGroupTest, SingleWorkerTest) {
+    // Every wait() inside a worker must run the children itself.
+    thread_pool_options options;
+    options.thread_count = 1;
+    thread_pool pool(options);
+    auto result = pool.submit([&pool] { return fib(pool, 20); });
+    EXPECT_EQ(result.get(), 6765);
+}
+
+TEST(TaskGroupTest, ExceptionCancelsSiblingsTest) {
+    thread_pool_options options;
+    options.thread_count = 2;
+    thread_pool pool(options);
+    task_group group(pool);
+
+    std::atomic<int> ran{0};
+    group.run([] { throw std::runtime_error("first"); });
+    for (int i = 0; i < 1000; ++i) {
+        group.run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); });
+    }
+    try {
+        group.wait();
+        FAIL() << "wait() did not rethrow";
+    } catch (const std::runtime_error &e) {
+        EXPECT_STREQ(e.what(), "first");
+    }
+    EXPECT_LT(ran.load(), 1000);
+
+    // The failure does not stick to the next round.
+    group.run([&ran] { ran.fetch_add(1); });
+    EXPECT_NO_THROW(group.wait());
+}
+
+TEST(TaskGroupTest, CancelTest) {
+    thread_pool_options options;
+    options.thread_count = 1;
+    thread_pool pool(options);
+    task_group group(pool);
+
+    std::atomic<bool> release{false};
+    std::atomic<int> ran{0};
+    // Occupy the only worker so the rest stay queued.
+    group.run([&] {
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    for (int i = 0; i < 100; ++i) {
+        group.run([&ran] { ran.fetch_add(1); });
+    }
+    group.cancel();
+    EXPECT_TRUE(group.is_canceling());
+    release = true;
+    group.wait();
+    EXPECT_EQ(ran.load(), 0);
+    EXPECT_FALSE(group.is_canceling());
+}
+
+TEST(TaskGroupTest, QuickSortTest) {
+    thread_pool_options options;
+    options.thread_count = 4;
+    thread_pool pool(options);
+    std::mt19937 rng(7);
+    std::list<int> input;
+    for (int i = 0; i < 20000; ++i) {
+        input.push_back(static_cast<int>(rng() % 100000));
+    }
+    std::list<int> expected = input;
+    expected.sort();
+    EXPECT_EQ(parallel_quick_sort(pool, input), expected);
+}
@@ -5,6 +5,9 @@
 #include <algorithm>
 #include <numeric>
 #include <future>
+#include <array>
+#include <atomic>
+#include <iterator>
 
 #include "data_structure/threadsafe_queue_linkedlist.h"
 #include "gtest/gtest.h"
@@ -199,3 +202,50 @@ TEST(ThreadSafeQueueListTest, MPMCTest) {
 //        std::cout << i + 1 << ": " << ans[i] << std::endl;
 //    }
 }
+
+TEST(ThreadSafeQueueListTest, PopBatchTest) {
+    threadsafe_queue<int> queue;
+    std::vector<int> out;
+    EXPECT_EQ(queue.try_pop_batch(std::back_inserter(out), 8), 0u);
+
+    for (int i = 0; i < 10; ++i) {
+        queue.push(i);
+    }
+    EXPECT_EQ(queue.try_pop_batch(std::back_inserter(out), 4), 4u);
+    EXPECT_EQ(out, (std::vector<int>{0, 1, 2, 3}));
+    EXPECT_EQ(queue.try_pop_batch(std::back_inserter(out), 100), 6u);
+    EXPECT_EQ(out.size(), 10u);
+    EXPECT_EQ(out.back(), 9);
+    EXPECT_TRUE(queue.empty());
+
+    // The queue keeps working after being emptied by a batch.
+    queue.push(42);
+    int value = 0;
+    EXPECT_TRUE(queue.try_pop(value));
+    EXPECT_EQ(value, 42);
+
+    std::atomic<int> popped{0};
+    std::thread producer([&] {
+        for (auto n: c.keys) {
+            queue.push(n);
+        }
+    });
+    std::vector<std::thread> consumers;
+    std::vector<long long> sums(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        consumers.emplace_back([&, t] {
+            std::array<int, 16> buffer;
+            while (popped < static_cast<int>(c.size)) {
+                const size_t n = queue.try_pop_batch(buffer.begin(), buffer.size());
+                sums[t] += std::accumulate(buffer.begin(), buffer.begin() + n, 0LL);
+                popped += static_cast<int>(n);
+            }
+        });
+    }
+    producer.join();
+    for (auto &t: consumers) {
+        t.join();
+    }
+    EXPECT_EQ(std::accumulate(sums.begin(), sums.end(), 0LL),
+              static_cast<long long>(c.size) * (c.size + 1) / 2);
+}
@@ -0,0 +1,168 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/thread_pool.h"
+#include "utils/timer_service.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Runs every task on the timer thread itself.
+struct inline_executor {
+    std::atomic<int> executed{0};
+
+    template<typename F>
+    void execute(F &&f) {
+        ++executed;
+        f();
+    }
+};
+
+using clock_type = std::chrono::steady_clock;
+
+// A one-worker pool whose worker is held by a task until open is set.
+struct held_pool {
+    std::atomic<bool> started{false};
+    std::atomic<bool> open{false};
+    thread_pool pool;
+
+    held_pool(size_t capacity, overflow_policy overflow) : pool([&] {
+        thread_pool_options options;
+        options.thread_count = 1;
+        options.queue_capacity = capacity;
+        options.overflow = overflow;
+        return options;
+    }()) {
+        pool.execute([this] {
+            started = true;
+            while (!open) {
+                std::this_thread::yield();
+            }
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+    }
+
+    ~held_pool() { open = true; }
+};
+
+}
+
+TEST(TimerServiceTest, FiresInOrderAndNotEarlyTest) {
+    inline_executor executor;
+    timer_service<inline_executor> timers(executor);
+    std::mutex mutex;
+    std::vector<std::pair<int, clock_type::duration>> fired;
+    const auto start = clock_type::now();
+    // 300ms lands on the second level of the wheel and has to cascade down.
+    for (int delay: {300, 20, 5, 40}) {
+        timers.schedule_after(std::chrono::milliseconds(delay), [&, delay] {
+            std::lock_guard lock(mutex);
+            fired.emplace_back(delay, clock_type::now() - start);
+        });
+    }
+    EXPECT_EQ(timers.pending(), 4u);
+    for (int i = 0; i < 200 && timers.pending() > 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    std::lock_guard lock(mutex);
+    ASSERT_EQ(fired.size(), 4u);
+    EXPECT_EQ(fired[0].first, 5);
+    EXPECT_EQ(fired[1].first, 20);
+    EXPECT_EQ(fired[2].first, 40);
+    EXPECT_EQ(fired[3].first, 300);
+    for (auto &[delay, when]: fired) {
+        EXPECT_GE(when, std::chrono::milliseconds(delay));
+    }
+}
+
+TEST(TimerServiceTest, CancelTest) {
+    inline_executor executor;
+    timer_service<inline_executor> timers(executor);
+    std::atomic<int> runs{0};
+    timer_id once = timers.schedule_after(std::chrono::milliseconds(10), [&] { ++runs; });
+    EXPECT_TRUE(timers.cancel(once));
+    EXPECT_FALSE(timers.cancel(once));
+    EXPECT_FALSE(timers.cancel(timer_id{}));
+
+    timer_id periodic = timers.schedule_every(std::chrono::milliseconds(2), [&] { ++runs; });
+    while (runs < 3) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(timers.cancel(periodic));
+    const int after_cancel = runs;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_LE(runs, after_cancel + 1);
+    EXPECT_EQ(timers.pending(), 0u);
+
+    // The freed node is reused; the stale id must not cancel the new timer.
+    timer_id reused = timers.schedule_after(std::chrono::hours(1), [] {});
+    EXPECT_FALSE(timers.cancel(once));
+    EXPECT_TRUE(timers.cancel(reused));
+}
+
+TEST(TimerServiceTest, ManyTimersTest) {
+    inline_executor executor;
+    timer_service<inline_executor> timers(executor);
+    constexpr int count = 200000;
+    std::vector<timer_id> ids;
+    ids.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        ids.push_back(timers.schedule_after(std::chrono::seconds(10) + std::chrono::milliseconds(i % 100000), [] {}));
+    }
+    EXPECT_EQ(timers.pending(), static_cast<size_t>(count));
+    for (auto id: ids) {
+        EXPECT_TRUE(timers.cancel(id));
+    }
+    EXPECT_EQ(timers.pending(), 0u);
+    EXPECT_EQ(executor.executed, 0);
+}
+
+TEST(TimerServiceTest, DestroyWaitsForQueuedFiresTest) {
+    held_pool held(0, overflow_policy::block);
+    auto timers = std::make_unique<timer_service<thread_pool>>(held.pool);
+    std::atomic<int> runs{0};
+    for (int i = 0; i < 8; ++i) {
+        timers->schedule_after(std::chrono::milliseconds(1), [&] { ++runs; });
+    }
+    while (timers->pending() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // All eight fires now sit in the pool's queue and point at the service.
+    std::atomic<bool> destroyed{false};
+    std::thread destroyer([&] {
+        timers.reset();
+        destroyed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(destroyed.load());
+    held.open = true;
+    destroyer.join();
+    EXPECT_EQ(runs.load(), 8);
+}
+
+TEST(TimerServiceTest, RejectedFireKeepsPeriodicTimerTest) {
+    held_pool held(1, overflow_policy::reject);
+    // Fills the only slot, so every fire is rejected until the worker is free.
+    held.pool.execute([] {});
+    timer_service<thread_pool> timers(held.pool);
+    std::atomic<int> runs{0};
+    timer_id id = timers.schedule_every(std::chrono::milliseconds(2), [&] { ++runs; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(runs.load(), 0);
+    EXPECT_GT(held.pool.backpressure().rejected, 0u);
+    held.open = true;
+    for (int i = 0; i < 1000 && runs < 3; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_GE(runs.load(), 3);
+    EXPECT_TRUE(timers.cancel(id));
+}
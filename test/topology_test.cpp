@@ -0,0 +1,69 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+
+#include "utils/topology.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+void write_file(const std::string &path, const std::string &content) {
+    std::string dir;
+    for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+        dir = path.substr(0, pos);
+        mkdir(dir.c_str(), 0755);
+    }
+    std::ofstream(path) << content << '\n';
+}
+
+// Two nodes, two cores per node, two hardware threads per core:
+// cpus 0-3 on node 0 (siblings 0/2, 1/3), cpus 4-7 on node 2.
+std::string make_fake_sysfs() {
+    char pattern[] = "/tmp/topology_testXXXXXX";
+    const std::string root = mkdtemp(pattern);
+    write_file(root + "/cpu/online", "0-7");
+    for (unsigned cpu = 0; cpu < 8; ++cpu) {
+        const std::string dir = root + "/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        write_file(dir + "core_id", std::to_string(cpu % 2));
+        write_file(dir + "physical_package_id", std::to_string(cpu / 4));
+    }
+    write_file(root + "/node/online", "0,2");
+    write_file(root + "/node/node0/cpulist", "0-3");
+    write_file(root + "/node/node2/cpulist", "4-7");
+    return root;
+}
+
+}
+
+TEST(TopologyTest, ParseCpuListTest) {
+    EXPECT_EQ(cpu_topology::parse_cpu_list("0-3,8,10-11\n"), (std::vector<unsigned>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(cpu_topology::parse_cpu_list("5"), (std::vector<unsigned>{5}));
+    EXPECT_TRUE(cpu_topology::parse_cpu_list("garbage").empty());
+}
+
+TEST(TopologyTest, ReadFakeSysfsTest) {
+    const std::string root = make_fake_sysfs();
+    cpu_topology topology = cpu_topology::read(root);
+    ASSERT_EQ(topology.cpus.size(), 8u);
+    EXPECT_EQ(topology.node_count, 2u);
+    EXPECT_EQ(topology.node_of_cpu(1), 0u);
+    EXPECT_EQ(topology.node_of_cpu(6), 1u);
+
+    // Distinct cores of node 0 first, then their siblings, then node 1.
+    std::vector<unsigned> order;
+    for (const auto &info: topology.placement_order()) {
+        order.push_back(info.cpu);
+    }
+    EXPECT_EQ(order, (std::vector<unsigned>{0, 1, 2, 3, 4, 5, 6, 7}));
+    std::system(("rm -rf " + root).c_str());
+}
+
+TEST(TopologyTest, MissingSysfsTest) {
+    cpu_topology topology = cpu_topology::read("/nonexistent");
+    EXPECT_FALSE(topology.cpus.empty());
+    EXPECT_EQ(topology.node_count, 1u);
+}
@@ -0,0 +1,57 @@
+//
+// Created by csq on 10/18/26.
+//
+#include <thread>
+#include <algorithm>
+#include <numeric>
+#include <atomic>
+
+#include "data_structure/work_stealing_queue.h"
+#include "gtest/gtest.h"
+
+TEST(WorkStealingQueueTest, OwnerLifoThiefFifoTest) {
+    work_stealing_queue<int> queue;
+    for (int i = 0; i < 4; ++i) {
+        queue.push(i);
+    }
+    int value;
+    EXPECT_TRUE(queue.try_pop(value));
+    EXPECT_EQ(value, 3);
+    EXPECT_TRUE(queue.try_steal(value));
+    EXPECT_EQ(value, 0);
+    EXPECT_EQ(queue.size(), 2);
+}
+
+TEST(WorkStealingQueueTest, ConcurrentStealTest) {
+    work_stealing_queue<int> queue;
+    const int size = 100000;
+    for (int i = 0; i < size; ++i) {
+        queue.push(i);
+    }
+
+    std::atomic<long> sum{0};
+    std::atomic<int> taken{0};
+    std::vector<std::thread> thread_group;
+    thread_group.emplace_back([&] {
+        int value;
+        while (queue.try_pop(value)) {
+            sum += value;
+            ++taken;
+        }
+    });
+    for (int i = 0; i < 3; ++i) {
+        thread_group.emplace_back([&] {
+            int value;
+            while (queue.try_steal(value)) {
+                sum += value;
+                ++taken;
+            }
+        });
+    }
+    for (auto &t: thread_group) {
+        t.join();
+    }
+    EXPECT_EQ(taken, size);
+    EXPECT_EQ(sum, static_cast<long>(size) * (size - 1) / 2);
+    EXPECT_TRUE(queue.empty());
+}